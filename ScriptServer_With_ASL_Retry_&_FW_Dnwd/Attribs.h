@@ -166,8 +166,8 @@ static struct {
 } ;
 
 /**
- * @see ScriptServer::match
- * match() return code
+ * @see ScriptServer::runMatch
+ * runMatch() return code
  */
 enum MATCH_TYPE
 {
@@ -0,0 +1,165 @@
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+#include "ConfigCache.h"
+#include "Flog.h"
+#include "SimpleIni.h"
+
+
+CConfigCache::CConfigCache( CReactor& reactor )
+	: m_rReactor(reactor)
+	, m_pSnapshot(NULL)
+	, m_nInotifyFd(-1)
+	, m_nReloads(0)
+{
+}
+
+
+CConfigCache::~CConfigCache()
+{
+	Close() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read the sections of a configuration file.
+/// @param fileName	Configuration file (ss.ini)
+/// @retval false when the file cannot be read; Get() then finds nothing
+////////////////////////////////////////////////////////////////////////////////
+bool CConfigCache::Load( const char* fileName )
+{
+	m_sFile = fileName ;
+	Snapshot* snapshot = new Snapshot ;
+	if ( !read(*snapshot) )
+	{
+		delete snapshot ;
+		return false ;
+	}
+	delete m_pSnapshot ;
+	m_pSnapshot = snapshot ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reload the values whenever the configuration file changes.
+/// @retval false when inotify is not available; the values loaded stay
+/// @remarks The directory is watched rather than the file, so that a file
+/// replaced by an editor (written aside and renamed) is seen as well.
+////////////////////////////////////////////////////////////////////////////////
+bool CConfigCache::Watch()
+{
+	if ( m_nInotifyFd != -1 )
+		return true ;
+	m_nInotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) ;
+	if ( m_nInotifyFd == -1 )
+	{
+		LOG_ERROR( "Error - inotify_init1: %s\n", strerror(errno) ) ;
+		return false ;
+	}
+	std::string dir( m_sFile, 0, m_sFile.rfind('/') == std::string::npos ? 0 : m_sFile.rfind('/') ) ;
+	if ( dir.empty() )
+		dir = "." ;
+	if ( inotify_add_watch( m_nInotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO ) == -1
+	||   !m_rReactor.Add( m_nInotifyFd, this ) )
+	{
+		LOG_ERROR( "Error - inotify_add_watch %s: %s\n", dir.c_str(), strerror(errno) ) ;
+		close( m_nInotifyFd ) ;
+		m_nInotifyFd = -1 ;
+		return false ;
+	}
+	LOG_INFO( "Watching %s for changes\n", m_sFile.c_str() ) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Value of an [EXPORT] key, NULL when it is not defined.
+////////////////////////////////////////////////////////////////////////////////
+const char* CConfigCache::Get( const char* key ) const
+{
+	return Get( "EXPORT", key ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Value of a key of a section, NULL when it is not defined.
+////////////////////////////////////////////////////////////////////////////////
+const char* CConfigCache::Get( const char* section, const char* key ) const
+{
+	if ( !m_pSnapshot )
+		return NULL ;
+	Snapshot::const_iterator sec = m_pSnapshot->find(section) ;
+	if ( sec == m_pSnapshot->end() )
+		return NULL ;
+	Section::const_iterator it = sec->second.find(key) ;
+	return it == sec->second.end() ? NULL : it->second.c_str() ;
+}
+
+
+void CConfigCache::OnReadable( int fd )
+{
+	size_t slash = m_sFile.rfind('/') ;
+	const char* name = m_sFile.c_str() + (slash == std::string::npos ? 0 : slash + 1) ;
+	bool changed = false ;
+
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event)))) ;
+	ssize_t n ;
+	while ( (n = ::read(fd, buf, sizeof(buf))) > 0 )
+	{
+		for ( char* p = buf; p < buf + n; )
+		{
+			const struct inotify_event* ev = (const struct inotify_event*)p ;
+			if ( ev->len && !strcmp(ev->name, name) )
+				changed = true ;
+			p += sizeof(struct inotify_event) + ev->len ;
+		}
+	}
+	if ( !changed )
+		return ;
+
+	Snapshot* snapshot = new Snapshot ;
+	if ( !read(*snapshot) )
+	{
+		LOG_ERROR( "Error - %s changed but cannot be read, values kept\n", m_sFile.c_str() ) ;
+		delete snapshot ;
+		return ;
+	}
+	delete m_pSnapshot ;
+	m_pSnapshot = snapshot ;
+	LOG_INFO( "CONFIG RELOAD: [file:%s] [keys:%u] [reloads:%u]\n", m_sFile.c_str(), (unsigned)(*snapshot)["EXPORT"].size(), ++m_nReloads ) ;
+}
+
+
+void CConfigCache::Close()
+{
+	if ( m_nInotifyFd != -1 )
+	{
+		m_rReactor.Remove( m_nInotifyFd ) ;
+		close( m_nInotifyFd ) ;
+		m_nInotifyFd = -1 ;
+	}
+	delete m_pSnapshot ;
+	m_pSnapshot = NULL ;
+}
+
+
+bool CConfigCache::read( Snapshot& snapshot ) const
+{
+	CSimpleIniA ini(false, true, true) ;
+	if ( ini.LoadFile(m_sFile.c_str()) != 0 )
+		return false ;
+
+	CSimpleIniA::TNamesDepend sections ;
+	ini.GetAllSections(sections) ;
+	for ( CSimpleIniA::TNamesDepend::iterator sec = sections.begin(); sec != sections.end(); ++sec )
+	{
+		Section& section = snapshot[sec->pItem] ;
+		CSimpleIniA::TNamesDepend keys ;
+		ini.GetAllKeys(sec->pItem, keys) ;
+		for ( CSimpleIniA::TNamesDepend::iterator it = keys.begin(); it != keys.end(); ++it )
+		{
+			const char* value = ini.GetValue(sec->pItem, it->pItem) ;
+			section[it->pItem] = value ? value : "" ;
+		}
+	}
+	return true ;
+}
@@ -0,0 +1,47 @@
+#ifndef _CONFIG_CACHE_H_
+#define _CONFIG_CACHE_H_
+
+#include <map>
+#include <string>
+
+#include "Reactor.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Values of ss.ini, read once and kept in memory.
+/// @remarks Get() is a lookup in the current snapshot, in [EXPORT] unless
+/// another section is given. A snapshot is never
+/// modified: when Watch() is on and the file changes, a complete new snapshot
+/// is read and replaces the current one between two reactor events, so a
+/// lookup sees either all the old or all the new values. A file that cannot
+/// be read keeps the current snapshot.
+////////////////////////////////////////////////////////////////////////////////
+class CConfigCache : public CReactorHandler {
+public:
+	CConfigCache( CReactor& reactor ) ;
+	~CConfigCache() ;
+
+public:
+	bool Load( const char* fileName ) ;
+	bool Watch() ;
+	bool Loaded() const { return m_pSnapshot != NULL ; }
+	const char* Get( const char* key ) const ;
+	const char* Get( const char* section, const char* key ) const ;
+	void Close() ;
+
+	void OnReadable( int fd ) ;
+
+protected:
+	typedef std::map<std::string, std::string> Section ;
+	typedef std::map<std::string, Section> Snapshot ;
+	bool read( Snapshot& snapshot ) const ;
+
+protected:
+	CReactor&	m_rReactor ;
+	std::string	m_sFile ;
+	Snapshot*	m_pSnapshot ;
+	int	m_nInotifyFd ;
+	unsigned m_nReloads ;
+} ;
+
+#endif	/* _CONFIG_CACHE_H_ */
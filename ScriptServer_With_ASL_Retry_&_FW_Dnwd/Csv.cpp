@@ -1,4 +1,5 @@
 #include "Csv.h"
+#include "Scan.h"
 
 struct CCsv::Impl {
 	unsigned  m_nTmpSz;
@@ -12,6 +13,9 @@ struct CCsv::Impl {
 	char m_cEnd ;
 	bool m_bEor;
 	char m_cEndMark ;
+	const char* m_pIn ;	///< line read from, not owned
+	const char* m_pInEnd ;
+	const char* m_pInIt ;
 	Impl()
 	: m_nTmpSz(512)
 	, m_pTmp(0)
@@ -24,6 +28,9 @@ struct CCsv::Impl {
 	, m_cEnd(']')
 	, m_bEor(false)
 	, m_cEndMark('\n')
+	, m_pIn("")
+	, m_pInEnd(m_pIn)
+	, m_pInIt(m_pIn)
 	{
 	}
 } ;
@@ -55,9 +62,12 @@ void CCsv::Eor(bool b)
 	m_pImpl->m_bEor = b;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rest of the line being read.
+////////////////////////////////////////////////////////////////////////////////
 const char * CCsv::CurrentIt() const
 {
-	return m_pImpl->m_pIt ;
+	return m_pImpl->m_pInIt ;
 }
 
 
@@ -68,16 +78,18 @@ const char* CCsv::GetLine()
 	return m_pImpl->m_pLine ;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-/// @brief Set the CSV line to read from
-////////////////////////////////////////////////////////////////////////////////
 CCsv& CCsv::SetLine(const char* line)
 {
-	free(m_pImpl->m_pLine);
+	return SetLine( line, strlen(line) ) ;
+}
+
+
+CCsv& CCsv::SetLine(const char* line, size_t len)
+{
 	m_pImpl->m_bEor  = false;
-	m_pImpl->m_pLine = strdup(line) ;
-	m_pImpl->m_pIt   = m_pImpl->m_pLine ;
-	m_pImpl->m_nLineSz = strlen(line);
+	m_pImpl->m_pIn   = line ;
+	m_pImpl->m_pInEnd = line + len ;
+	m_pImpl->m_pInIt = line ;
 	return *this ;
 }
 
@@ -192,9 +204,18 @@ void CCsv::Put(const char* in, size_t inLen)
 
 CCsv& CCsv::Get(int& out)
 {
+	const char* value ;
+	size_t len ;
 	int rb, rf ;
 
-	readValue() ;
+	readValue(value, len) ;
+	if ( len >= m_pImpl->m_nTmpSz )
+	{
+		m_pImpl->m_nTmpSz = len + 1 ;
+		m_pImpl->m_pTmp = (char*)realloc(m_pImpl->m_pTmp, m_pImpl->m_nTmpSz) ;
+	}
+	memcpy( m_pImpl->m_pTmp, value, len ) ;
+	m_pImpl->m_pTmp[len] = 0 ;
 	rf = sscanf( m_pImpl->m_pTmp, "%i%n", &out,&rb );
 	if ( rf != 1 )
 		out = 0;
@@ -203,68 +224,75 @@ CCsv& CCsv::Get(int& out)
 
 CCsv& CCsv::Get(char*&out)
 {
-	readValue() ;
-	out = strdup(m_pImpl->m_pTmp);
+	const char* value ;
+	size_t len ;
+	readValue(value, len) ;
+	out = (char*)malloc(len + 1) ;
+	memcpy( out, value, len ) ;
+	out[len] = 0 ;
 	return *this ;
 }
 CCsv& CCsv::Get(std::string&out)
 {
-	readValue();
-	out.assign(m_pImpl->m_pTmp);
+	const char* value ;
+	size_t len ;
+	readValue(value, len) ;
+	out.assign(value, len) ;
+	return *this ;
+}
+
+CCsv& CCsv::Get(const char*& out, size_t& outLen)
+{
+	readValue(out, outLen) ;
 	return *this ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Read a string from the CSV line
+/// @param value,len	Value read, in the line
 /// @retval false when end of line was reached
 /// @remarks Read from CSV line until a separator or the end of line is reached.
 ////////////////////////////////////////////////////////////////////////////////
-bool CCsv::readValue()
+bool CCsv::readValue( const char*& value, size_t& len )
 {
+	const char* end = m_pImpl->m_pInEnd ;
 	bool waitEnd = false ;
 	m_pImpl->m_bEor = false ;
-	if ( *m_pImpl->m_pIt == m_pImpl->m_cBegining )
+	if ( m_pImpl->m_pInIt < end && *m_pImpl->m_pInIt == m_pImpl->m_cBegining )
 	{
-		++m_pImpl->m_pIt ;
+		++m_pImpl->m_pInIt ;
 		waitEnd = true ;
 	}
 
-	int i ;
-	for ( i=0
-		; *m_pImpl->m_pIt != m_pImpl->m_cSeparator
-			&& m_pImpl->m_pIt != m_pImpl->m_pLine+m_pImpl->m_nLineSz
-			&& *m_pImpl->m_pIt != m_pImpl->m_cEndMark
-		; ++m_pImpl->m_pIt,++i )
+	size_t left = m_pImpl->m_pInIt < end ? end - m_pImpl->m_pInIt : 0 ;
+	size_t i = ::scanFirstOf( m_pImpl->m_pInIt, left
+				, m_pImpl->m_cSeparator
+				, m_pImpl->m_cEndMark
+				, waitEnd ? m_pImpl->m_cEnd : m_pImpl->m_cSeparator ) ;
+	value = m_pImpl->m_pInIt ;
+	len = i ;
+	m_pImpl->m_pInIt += i ;
+
+	if ( waitEnd && i < left && *m_pImpl->m_pInIt == m_pImpl->m_cEnd )
 	{
-		m_pImpl->m_pTmp[i] = *m_pImpl->m_pIt ;
-		if ( *m_pImpl->m_pIt == m_pImpl->m_cEnd && waitEnd )
+		++m_pImpl->m_pInIt ;
+		if ( m_pImpl->m_pInIt < end
+		&& ( *m_pImpl->m_pInIt == m_pImpl->m_cSeparator || *m_pImpl->m_pInIt == m_pImpl->m_cEndMark ) )
 		{
-			++m_pImpl->m_pIt ;
-			if ( *m_pImpl->m_pIt == m_pImpl->m_cSeparator
-			||   *m_pImpl->m_pIt == m_pImpl->m_cEndMark )
-			{
-				m_pImpl->m_bEor = true ;
-			}
-			break ;
+			m_pImpl->m_bEor = true ;
 		}
 	}
 
-	if ( *m_pImpl->m_pIt == m_pImpl->m_cEndMark )
+	if ( m_pImpl->m_pInIt < end && *m_pImpl->m_pInIt == m_pImpl->m_cEndMark )
 	{
 		m_pImpl->m_bEor = true;
 	}
 
-	m_pImpl->m_pTmp[i]= 0 ;
-
-	if ( *m_pImpl->m_pIt == m_pImpl->m_cSeparator )
-	{
-		++m_pImpl->m_pIt ;
-	}
-	if ( m_pImpl->m_pIt==m_pImpl->m_pLine+m_pImpl->m_nLineSz )
+	if ( m_pImpl->m_pInIt < end && *m_pImpl->m_pInIt == m_pImpl->m_cSeparator )
 	{
-		return false ;
+		++m_pImpl->m_pInIt ;
 	}
-	return true ;
+	return m_pImpl->m_pInIt < end ;
 }
 
 
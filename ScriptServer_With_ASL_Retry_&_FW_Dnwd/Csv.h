@@ -20,7 +20,15 @@ public:
 	void Eor(bool) ;
 	const char* CurrentIt() const ;
 	const char* GetLine() ;
+
+	//////////////////////////////////////////////////////////////////////////////
+	/// @brief Set the CSV line to read from.
+	/// @remarks The line is not copied: the Get() views point into it, and it
+	/// must outlive the reading. It needs no NUL after len bytes, so a field
+	/// read from another CCsv can be read in turn.
+	//////////////////////////////////////////////////////////////////////////////
 	CCsv& SetLine( const char* line ) ;
+	CCsv& SetLine( const char* line, size_t len ) ;
 	void SetSeparator( char sep, char eor='\n' ) ;
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -58,8 +66,14 @@ public:
 	CCsv& Get( char*&out ) ;
 	CCsv& Get( std::string&out) ;
 
+	//////////////////////////////////////////////////////////////////////////////
+	/// @brief Get a string out the CSV line, as a view into the line: nothing
+	/// is copied and the value is not NUL terminated.
+	//////////////////////////////////////////////////////////////////////////////
+	CCsv& Get( const char*& out, size_t& outLen ) ;
+
 protected:
-	bool readValue() ;
+	bool readValue( const char*& value, size_t& len ) ;
 	void addFreeSpace( int extra ) ;
 	void updateIt( int rv ) ;
 
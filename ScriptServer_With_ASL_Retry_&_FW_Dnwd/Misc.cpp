@@ -1,5 +1,6 @@
 #include "Misc.h"
 #include "SimpleIni.h"
+#include "Transport.h"
 
 Config g_oCfg ;
 
@@ -41,42 +42,11 @@ void getTaiTime()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Send a line on UDP.
+/// @brief Append the TAI time to a line when its message type carries one.
+/// @param line		Message to stamp
 ////////////////////////////////////////////////////////////////////////////////
-int sendline(Params params, std::stringstream& line)
+void stampline(std::stringstream& line)
 {
-	int rv ;
-	if ( !line )
-	{
-		LOG_ERROR( "Error - sendline: null line\n") ;
-		return false ;
-	}
-
-	struct sockaddr_in si_other ;
-	int s, slen = sizeof(si_other) ;
-	if ( (s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1 )
-		diep("socket") ;
-
-	memset((char *) &si_other, 0, sizeof(si_other)) ;
-	si_other.sin_family = AF_INET ;
-	si_other.sin_port = htons(params.backbonePort) ;
-	if ( 0 == inet_aton(params.host, &si_other.sin_addr) )
-	{
-		LOG_ERROR( "Error - inet_aton(host:%s,port:%i) failed\n", params.host, params.backbonePort ) ;
-		exit(1) ;
-	}
-	struct sockaddr_in servaddr ;
-	bzero(&servaddr, sizeof(servaddr)) ;
-	servaddr.sin_family = AF_INET ;
-	servaddr.sin_addr.s_addr = htonl(INADDR_ANY) ;
-	servaddr.sin_port = htons(params.backbonePort) ;
-	rv = bind(s, (struct sockaddr *) &servaddr, sizeof(servaddr)) ;
-	if( 0 != rv )
-	{
-		LOG_ERROR("Error - Unable to bind(port:%u)", params.backbonePort ) ;
-		exit(1);
-	}
-
 	int type ;
 	::getMsgType(line.str().c_str(), type/*, false*/);
 	if ( type == TX_RF || type==TX_CFG || type==TX_RSP )
@@ -84,13 +54,27 @@ int sendline(Params params, std::stringstream& line)
 		getTaiTime();
 		line << g_oCfg.sec_frac ;
 	}
-	if ( sendto(s, line.str().c_str(), line.str().length(), 0, (const sockaddr*) &si_other, slen)
-			== -1 )
-		diep("sendto()") ;
-	else
-		LOG_INFO("\tSENT UDP: [%s]: [host:%s] [port:%d] [%s]\n", szNow(), params.host, params.backbonePort, line.str().c_str() ) ;
+}
 
-	close(s) ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send a line on UDP.
+/// @param transport	Transport holding the RF node sockets
+/// @param params	Message parameters; params.rfNode selects the socket
+/// @param line		Message to send
+////////////////////////////////////////////////////////////////////////////////
+int sendline(CUdpTransport& transport, Params& params, std::stringstream& line)
+{
+	if ( !line )
+	{
+		LOG_ERROR( "Error - sendline: null line\n") ;
+		return false ;
+	}
+
+	stampline(line) ;
+	std::string out( line.str() ) ;
+	if ( !transport.Send(params.rfNode, out.c_str(), out.length()) )
+		return false ;
+
+	LOG_INFO("\tSENT UDP: [%s]: [host:%s] [port:%d] [%s]\n", szNow(), params.host, params.backbonePort, out.c_str() ) ;
 	return true ;
 }
-
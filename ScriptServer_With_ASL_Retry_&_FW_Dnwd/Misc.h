@@ -21,6 +21,7 @@
 #include "Flog.h"
 #include "ConsoleFileSync.h"
 #include "Csv.h"
+#include "Storage.h"
 
 struct cmp_str {
 	bool operator()(char const *a, char const *b)
@@ -30,17 +31,40 @@ struct cmp_str {
 } ;
 
 
+/// @brief Loop of a MSG: "start;end;increment[;pace[;batch]][;rate=R][;burst=B][;jitter=J]".
+/// @remarks start, end and increment are hex, the other fields decimal.
+/// When pace is given the expanded iterations are sent in batches of batch
+/// datagrams spaced by pace ms. Otherwise they are paced by the send
+/// scheduler at rate msgs/s with bursts of burst messages and up to jitter us
+/// of random delay; rate 0 falls back to the RF node rate (ss.ini).
 struct loop_spec {
 	int start ;
 	int end ;
 	int increment ;
-	loop_spec() : start(0),end(0),increment(0) {}
+	int pace ;
+	int batch ;
+	double rate ;
+	unsigned burst ;
+	unsigned jitterUs ;
+	loop_spec() : start(0),end(0),increment(0),pace(-1),batch(0),rate(0),burst(0),jitterUs(0) {}
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait/Match elements of a step compiled for the match.
+////////////////////////////////////////////////////////////////////////////////
+struct MatchProgram {
+	int	msgType ;	///< type checked once for the whole step
+	bool	mixed ;		///< elements wait for different types: checked one by one
+	std::vector<struct MatchOp> ops ;	///< in message order: by layer, then offset
+	std::vector<unsigned char> bits ;	///< decoded masks and values, and literal data
+	MatchProgram() : msgType(MSG_UNKNOWN), mixed(false) {}
+} ;
+
 struct Params {
 char *desc;
 	char *currentId ;
 	int  msgType ;
+	const char *rfNode ;
 	char host[256] ;
 	int  ackLoggerPort ;
 	int  backbonePort ;
@@ -48,11 +72,13 @@ char *desc;
 	int  policy ;
 	struct loop_spec loop ;
 	std::vector<struct Tagwait> WaitVec ;
+	struct MatchProgram Match ;
 	std::vector<struct TagModify> LoadVec ;
 	std::vector<struct TagModify> StoreVec ;
 	Params( )
 	:msgType(MSG_UNKNOWN)
 	,currentId(NULL)
+	,rfNode(NULL)
 	{
 		msgType = MSG_UNKNOWN ;
 		currentId=NULL;
@@ -68,19 +94,28 @@ struct Config {
 	char	logFile[256] ;
 	int  loopIdx ;
 	char LogLevel ;
-	std::map<char*, char*,cmp_str> StorageMap ;
+	bool Parallel ;
+	bool WatchConfig ;
+	CStorage Storage ;	///< values saved by the script
+	const char *StorageFile ;	///< -s: snapshot of Storage kept between runs, NULL when none
 	Config()
-		: InCsvFile(NULL)
-		, DefaultTimeout(600)
+		: DefaultTimeout(600)
+		, InCsvFile(NULL)
 		, LogLevel(CFLog::LL_ERROR|CFLog::LL_DEBUG|CFLog::LL_INFO)
+		, Parallel(false)
+		, WatchConfig(false)
+		, StorageFile(NULL)
 	{
 	}
 } ;
 
+class CUdpTransport ;
+
 bool  getMsgType(CCsv&, int&/*, bool log=true*/) ;
 bool  getMsgType(const char*, int&/*, bool log=true*/) ;
 void  diep(char const *s) ;
-int   sendline(Params params, std::stringstream& line) ;
+int   sendline(CUdpTransport& transport, Params& params, std::stringstream& line) ;
+void  stampline(std::stringstream& line) ;
 char* szNow(void) ;
 
 
@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "MsgView.h"
+#include "Attribs.h"
+#include "Misc.h"
+#include "Scan.h"
+
+
+CMsgView::CMsgView()
+	: m_pMsg(NULL)
+	, m_nLen(0)
+	, m_nType(MSG_UNKNOWN)
+	, m_pLastBrace(NULL)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Split a message into its fields.
+/// @param msg	Message, NUL terminated; NULL gives a view with no field
+/// @param typed	false for a bare field value (a saved id): the type is not
+/// looked for and stays MSG_UNKNOWN
+////////////////////////////////////////////////////////////////////////////////
+void CMsgView::Parse( char* msg, bool typed )
+{
+	m_pMsg = msg ;
+	m_nLen = 0 ;
+	m_nType = MSG_UNKNOWN ;
+	m_pLastBrace = NULL ;
+	m_vStart.clear() ;
+	m_vBytes.clear() ;
+	m_vDecoded.clear() ;
+	if ( !msg )
+		return ;
+
+	// the commas land in m_vStart after the first start, then move one byte on
+	size_t lastBrace ;
+	m_vStart.push_back(0) ;
+	m_nLen = ::scanLine( msg, ',', '{', m_vStart, lastBrace ) ;
+	for ( size_t i = 1; i < m_vStart.size(); ++i )
+		++m_vStart[i] ;
+	if ( lastBrace != SCAN_NONE )
+		m_pLastBrace = msg + lastBrace ;
+	m_vDecoded.assign( m_vStart.size(), -1 ) ;
+	m_vDigits.resize( m_vStart.size() ) ;
+	/* room for every field: decoding one never moves the others */
+	m_vBytes.reserve( m_nLen / 2 + 2 * m_vStart.size() ) ;
+	if ( typed )
+		::getMsgType(msg, m_nType) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start of field i: the text after the i-th comma.
+/// @retval NULL when the message has fewer fields
+////////////////////////////////////////////////////////////////////////////////
+char* CMsgView::Field( int i ) const
+{
+	if ( i < 0 || (unsigned)i >= m_vStart.size() )
+		return NULL ;
+	return m_pMsg + m_vStart[i] ;
+}
+
+
+size_t CMsgView::FieldLength( int i ) const
+{
+	if ( i < 0 || (unsigned)i >= m_vStart.size() )
+		return 0 ;
+	size_t end = (unsigned)i + 1 < m_vStart.size() ? m_vStart[i+1] - 1 : m_nLen ;
+	return end - m_vStart[i] ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief First comma at or after a position of the message.
+/// @retval NULL when the position is in the last field or past the message
+////////////////////////////////////////////////////////////////////////////////
+char* CMsgView::Comma( const char* at ) const
+{
+	if ( !m_pMsg || at < m_pMsg || at >= m_pMsg + m_nLen )
+		return NULL ;
+	std::vector<unsigned>::const_iterator next
+		= std::upper_bound( m_vStart.begin(), m_vStart.end(), (unsigned)(at - m_pMsg) ) ;
+	if ( next == m_vStart.end() )
+		return NULL ;
+	return m_pMsg + *next - 1 ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Tell whether a '{' follows a position of the message, that is
+/// whether the rest of the message may hold placeholders.
+////////////////////////////////////////////////////////////////////////////////
+bool CMsgView::Placeholders( const char* from ) const
+{
+	return m_pLastBrace && m_pLastBrace >= from ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bytes of field i, decoded from its hex digits on the first call.
+/// @param digits	Hex digits decoded: the field is hex up to there only
+/// @retval NULL when the message has fewer fields
+/// @remarks The bytes stay valid until the next Parse().
+////////////////////////////////////////////////////////////////////////////////
+const unsigned char* CMsgView::Bytes( int i, size_t& digits ) const
+{
+	digits = 0 ;
+	if ( i < 0 || (unsigned)i >= m_vStart.size() )
+		return NULL ;
+	if ( m_vDecoded[i] < 0 )
+	{
+		size_t n = FieldLength(i) ;
+		size_t at = m_vBytes.size() ;
+		m_vBytes.resize( at + n / 2 + 1 ) ;
+		m_vDigits[i] = ::hexDecode( m_pMsg + m_vStart[i], n, &m_vBytes[at] ) ;
+		m_vDecoded[i] = at ;
+	}
+	digits = m_vDigits[i] ;
+	return &m_vBytes[ m_vDecoded[i] ] ;
+}
@@ -0,0 +1,46 @@
+#ifndef _MSG_VIEW_H_
+#define _MSG_VIEW_H_
+
+#include <cstddef>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fields of a CSV message, split once.
+/// @remarks Parse() walks the message a single time and records where each
+/// field starts and the message type; Field() and Comma() are then lookups,
+/// so a message is not walked again for every Wait/Match, Save and Copy
+/// element. The view points into the message it was given and does not own it.
+/// Bytes() decodes the hex digits of a field the first time it is asked for,
+/// so that the matcher and the Save operations read the bytes of a layer
+/// instead of parsing its text again.
+////////////////////////////////////////////////////////////////////////////////
+class CMsgView {
+public:
+	CMsgView() ;
+
+public:
+	void Parse( char* msg, bool typed = true ) ;
+
+	char* Data() const { return m_pMsg ; }
+	size_t Length() const { return m_nLen ; }
+	int Type() const { return m_nType ; }
+	unsigned Fields() const { return m_vStart.size() ; }
+	char* Field( int i ) const ;
+	size_t FieldLength( int i ) const ;
+	char* Comma( const char* at ) const ;
+	bool Placeholders( const char* from ) const ;
+	const unsigned char* Bytes( int i, size_t& digits ) const ;
+
+protected:
+	char*	m_pMsg ;
+	size_t	m_nLen ;
+	int	m_nType ;
+	const char* m_pLastBrace ;	///< last '{' of the message, NULL when none
+	std::vector<unsigned> m_vStart ;	///< field i starts at m_pMsg + m_vStart[i]
+	mutable std::vector<unsigned char> m_vBytes ;	///< decoded fields, reserved by Parse()
+	mutable std::vector<int> m_vDecoded ;	///< field i decoded at m_vBytes[m_vDecoded[i]], -1 until asked
+	mutable std::vector<unsigned> m_vDigits ;	///< hex digits at the start of field i
+} ;
+
+#endif	/* _MSG_VIEW_H_ */
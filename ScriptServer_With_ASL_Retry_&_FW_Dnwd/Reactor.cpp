@@ -0,0 +1,93 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+#include "Reactor.h"
+#include "Flog.h"
+
+/// events handled per epoll_wait() call
+#define REACTOR_MAX_EVENTS	32
+
+
+CReactor::CReactor()
+	: m_nEpollFd(-1)
+{
+}
+
+
+CReactor::~CReactor()
+{
+	if ( m_nEpollFd != -1 )
+		close(m_nEpollFd) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create the epoll set.
+/// @retval false when it could not be created
+////////////////////////////////////////////////////////////////////////////////
+bool CReactor::Open()
+{
+	if ( m_nEpollFd != -1 )
+		return true ;
+	m_nEpollFd = epoll_create(REACTOR_MAX_EVENTS) ;
+	if ( m_nEpollFd == -1 )
+	{
+		LOG_ERROR( "Error - epoll_create: %s\n", strerror(errno) ) ;
+		return false ;
+	}
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Watch a descriptor for readability.
+/// @retval false when the descriptor could not be added to the epoll set
+////////////////////////////////////////////////////////////////////////////////
+bool CReactor::Add( int fd, CReactorHandler* handler )
+{
+	struct epoll_event ev ;
+	memset( &ev, 0, sizeof(ev) ) ;
+	ev.events = EPOLLIN ;
+	ev.data.fd = fd ;
+	if ( epoll_ctl(m_nEpollFd, EPOLL_CTL_ADD, fd, &ev) == -1 )
+	{
+		LOG_ERROR( "Error - epoll_ctl(add fd:%i): %s\n", fd, strerror(errno) ) ;
+		return false ;
+	}
+	m_oHandlers[fd] = handler ;
+	return true ;
+}
+
+
+bool CReactor::Remove( int fd )
+{
+	if ( m_oHandlers.erase(fd) == 0 )
+		return false ;
+	struct epoll_event ev ;
+	epoll_ctl(m_nEpollFd, EPOLL_CTL_DEL, fd, &ev) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait for ready descriptors and dispatch them.
+/// @param timeoutMs	Maximum time to wait; 0 only polls
+/// @retval number of events dispatched, -1 on error
+////////////////////////////////////////////////////////////////////////////////
+int CReactor::RunOnce( int timeoutMs )
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS] ;
+	int n = epoll_wait(m_nEpollFd, events, REACTOR_MAX_EVENTS, timeoutMs < 0 ? 0 : timeoutMs) ;
+	if ( n == -1 )
+	{
+		if ( errno == EINTR ) return 0 ;
+		LOG_ERROR( "Error - epoll_wait: %s\n", strerror(errno) ) ;
+		return -1 ;
+	}
+	for ( int i = 0; i < n; ++i )
+	{
+		std::map<int, CReactorHandler*>::iterator it = m_oHandlers.find(events[i].data.fd) ;
+		if ( it != m_oHandlers.end() )
+			it->second->OnReadable( it->first ) ;
+	}
+	return n ;
+}
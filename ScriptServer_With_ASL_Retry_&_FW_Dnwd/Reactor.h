@@ -0,0 +1,38 @@
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Receiver of the readiness events dispatched by CReactor.
+////////////////////////////////////////////////////////////////////////////////
+class CReactorHandler {
+public:
+	virtual ~CReactorHandler() {}
+	virtual void OnReadable( int fd ) = 0 ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief epoll based event loop.
+/// @remarks Every registered descriptor is watched at once; RunOnce() waits
+/// for the first ready ones and hands them to their handler. Open() must
+/// succeed before anything is added.
+////////////////////////////////////////////////////////////////////////////////
+class CReactor {
+public:
+	CReactor() ;
+	~CReactor() ;
+
+public:
+	bool Open() ;
+	bool Add( int fd, CReactorHandler* handler ) ;
+	bool Remove( int fd ) ;
+	int  RunOnce( int timeoutMs ) ;
+
+protected:
+	int	m_nEpollFd ;
+	std::map<int, CReactorHandler*> m_oHandlers ;
+} ;
+
+#endif	/* _REACTOR_H_ */
@@ -0,0 +1,462 @@
+#include <cstring>
+#include <stdint.h>
+
+#include "Scan.h"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define SCAN_X86	1
+#include <immintrin.h>
+#endif
+
+/// ASCII upper case letters to lower case, every other byte as it is
+static inline unsigned char foldCase( unsigned char c )
+{
+	return ( c >= 'A' && c <= 'Z' ) ? c | 0x20 : c ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// scalar
+////////////////////////////////////////////////////////////////////////////////
+
+static size_t scanLineScalar( const char* s, char sep, char mark, std::vector<unsigned>& seps, size_t& lastMark )
+{
+	const char* p = s ;
+	lastMark = SCAN_NONE ;
+	for ( ; *p; ++p )
+	{
+		if ( *p == sep )
+			seps.push_back( p - s ) ;
+		else if ( *p == mark )
+			lastMark = p - s ;
+	}
+	return p - s ;
+}
+
+
+static size_t scanFirstOfScalar( const char* s, size_t n, char a, char b, char c )
+{
+	for ( size_t i = 0; i < n; ++i )
+		if ( s[i] == a || s[i] == b || s[i] == c )
+			return i ;
+	return n ;
+}
+
+
+static bool hexEqualScalar( const char* a, const char* b, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+		if ( foldCase(a[i]) != foldCase(b[i]) )
+			return false ;
+	return true ;
+}
+
+#ifdef SCAN_X86
+////////////////////////////////////////////////////////////////////////////////
+// SSE2
+// scanLine() reads whole aligned blocks: a block holding the NUL never
+// crosses a page the line does not reach, so reading it cannot fault. The
+// address sanitizer would still report the bytes around the line.
+////////////////////////////////////////////////////////////////////////////////
+
+/// bits of the bytes before the NUL, all bits when there is no NUL
+static inline unsigned beforeNul( unsigned nul )
+{
+	return nul ? (nul & (0u - nul)) - 1 : ~0u ;
+}
+
+
+static inline void pushBits( unsigned bits, size_t at, std::vector<unsigned>& seps )
+{
+	while ( bits )
+	{
+		seps.push_back( at + __builtin_ctz(bits) ) ;
+		bits &= bits - 1 ;
+	}
+}
+
+
+__attribute__((target("sse2"), no_sanitize_address))
+static size_t scanLineSse2( const char* s, char sep, char mark, std::vector<unsigned>& seps, size_t& lastMark )
+{
+	const __m128i vSep = _mm_set1_epi8(sep) ;
+	const __m128i vMark = _mm_set1_epi8(mark) ;
+	const __m128i vNul = _mm_setzero_si128() ;
+	const char* p = (const char*)( (uintptr_t)s & ~(uintptr_t)15 ) ;
+	unsigned valid = 0xFFFFu << (s - p) ;
+
+	lastMark = SCAN_NONE ;
+	for ( ;; p += 16, valid = 0xFFFFu )
+	{
+		__m128i v = _mm_load_si128( (const __m128i*)p ) ;
+		unsigned nul = _mm_movemask_epi8( _mm_cmpeq_epi8(v, vNul) ) & valid ;
+		valid &= beforeNul(nul) ;
+		unsigned seen = _mm_movemask_epi8( _mm_cmpeq_epi8(v, vSep) ) & valid ;
+		unsigned marks = _mm_movemask_epi8( _mm_cmpeq_epi8(v, vMark) ) & valid ;
+		pushBits( seen, p - s, seps ) ;
+		if ( marks )
+			lastMark = (p - s) + 31 - __builtin_clz(marks) ;
+		if ( nul )
+			return (p - s) + __builtin_ctz(nul) ;
+	}
+}
+
+
+__attribute__((target("sse2")))
+static size_t scanFirstOfSse2( const char* s, size_t n, char a, char b, char c )
+{
+	const __m128i va = _mm_set1_epi8(a) ;
+	const __m128i vb = _mm_set1_epi8(b) ;
+	const __m128i vc = _mm_set1_epi8(c) ;
+	size_t i = 0 ;
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)(s + i) ) ;
+		__m128i hit = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb) ), _mm_cmpeq_epi8(v, vc) ) ;
+		unsigned bits = _mm_movemask_epi8(hit) ;
+		if ( bits )
+			return i + __builtin_ctz(bits) ;
+	}
+	return i + scanFirstOfScalar( s + i, n - i, a, b, c ) ;
+}
+
+
+__attribute__((target("sse2")))
+static inline __m128i foldCase16( __m128i v )
+{
+	__m128i upper = _mm_and_si128( _mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z'+1)) ) ;
+	return _mm_or_si128( v, _mm_and_si128(upper, _mm_set1_epi8(0x20)) ) ;
+}
+
+
+__attribute__((target("sse2")))
+static bool hexEqualSse2( const char* a, const char* b, size_t n )
+{
+	size_t i = 0 ;
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i va = foldCase16( _mm_loadu_si128((const __m128i*)(a + i)) ) ;
+		__m128i vb = foldCase16( _mm_loadu_si128((const __m128i*)(b + i)) ) ;
+		if ( _mm_movemask_epi8( _mm_cmpeq_epi8(va, vb) ) != 0xFFFF )
+			return false ;
+	}
+	return hexEqualScalar( a + i, b + i, n - i ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2"), no_sanitize_address))
+static size_t scanLineAvx2( const char* s, char sep, char mark, std::vector<unsigned>& seps, size_t& lastMark )
+{
+	const __m256i vSep = _mm256_set1_epi8(sep) ;
+	const __m256i vMark = _mm256_set1_epi8(mark) ;
+	const __m256i vNul = _mm256_setzero_si256() ;
+	const char* p = (const char*)( (uintptr_t)s & ~(uintptr_t)31 ) ;
+	unsigned valid = ~0u << (s - p) ;
+
+	lastMark = SCAN_NONE ;
+	for ( ;; p += 32, valid = ~0u )
+	{
+		__m256i v = _mm256_load_si256( (const __m256i*)p ) ;
+		unsigned nul = (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8(v, vNul) ) & valid ;
+		valid &= beforeNul(nul) ;
+		unsigned seen = (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8(v, vSep) ) & valid ;
+		unsigned marks = (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8(v, vMark) ) & valid ;
+		pushBits( seen, p - s, seps ) ;
+		if ( marks )
+			lastMark = (p - s) + 31 - __builtin_clz(marks) ;
+		if ( nul )
+			return (p - s) + __builtin_ctz(nul) ;
+	}
+}
+
+
+__attribute__((target("avx2")))
+static size_t scanFirstOfAvx2( const char* s, size_t n, char a, char b, char c )
+{
+	const __m256i va = _mm256_set1_epi8(a) ;
+	const __m256i vb = _mm256_set1_epi8(b) ;
+	const __m256i vc = _mm256_set1_epi8(c) ;
+	size_t i = 0 ;
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		__m256i v = _mm256_loadu_si256( (const __m256i*)(s + i) ) ;
+		__m256i hit = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb) ), _mm256_cmpeq_epi8(v, vc) ) ;
+		unsigned bits = (unsigned)_mm256_movemask_epi8(hit) ;
+		if ( bits )
+			return i + __builtin_ctz(bits) ;
+	}
+	return i + scanFirstOfSse2( s + i, n - i, a, b, c ) ;
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i foldCase32( __m256i v )
+{
+	__m256i upper = _mm256_and_si256( _mm256_cmpgt_epi8(v, _mm256_set1_epi8('A'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z'+1), v) ) ;
+	return _mm256_or_si256( v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)) ) ;
+}
+
+
+__attribute__((target("avx2")))
+static bool hexEqualAvx2( const char* a, const char* b, size_t n )
+{
+	size_t i = 0 ;
+	for ( ; i + 32 <= n; i += 32 )
+	{
+		__m256i va = foldCase32( _mm256_loadu_si256((const __m256i*)(a + i)) ) ;
+		__m256i vb = foldCase32( _mm256_loadu_si256((const __m256i*)(b + i)) ) ;
+		if ( (unsigned)_mm256_movemask_epi8( _mm256_cmpeq_epi8(va, vb) ) != ~0u )
+			return false ;
+	}
+	return hexEqualSse2( a + i, b + i, n - i ) ;
+}
+#endif	/* SCAN_X86 */
+
+////////////////////////////////////////////////////////////////////////////////
+// dispatch
+////////////////////////////////////////////////////////////////////////////////
+
+struct ScanKernels {
+	const char* name ;
+	size_t (*line)( const char*, char, char, std::vector<unsigned>&, size_t& ) ;
+	size_t (*firstOf)( const char*, size_t, char, char, char ) ;
+	bool (*hex)( const char*, const char*, size_t ) ;
+} ;
+
+
+static ScanKernels pickKernels()
+{
+	ScanKernels k = { "scalar", scanLineScalar, scanFirstOfScalar, hexEqualScalar } ;
+#ifdef SCAN_X86
+	__builtin_cpu_init() ;
+	if ( __builtin_cpu_supports("avx2") )
+	{
+		ScanKernels avx2 = { "avx2", scanLineAvx2, scanFirstOfAvx2, hexEqualAvx2 } ;
+		return avx2 ;
+	}
+	if ( __builtin_cpu_supports("sse2") )
+	{
+		ScanKernels sse2 = { "sse2", scanLineSse2, scanFirstOfSse2, hexEqualSse2 } ;
+		return sse2 ;
+	}
+#endif
+	return k ;
+}
+
+
+static const ScanKernels& kernels()
+{
+	static const ScanKernels k = pickKernels() ;
+	return k ;
+}
+
+
+size_t scanLine( const char* s, char sep, char mark, std::vector<unsigned>& seps, size_t& lastMark )
+{
+	return kernels().line( s, sep, mark, seps, lastMark ) ;
+}
+
+
+size_t scanFirstOf( const char* s, size_t n, char a, char b, char c )
+{
+	return kernels().firstOf( s, n, a, b, c ) ;
+}
+
+
+bool hexEqual( const char* a, const char* b, size_t n )
+{
+	return kernels().hex( a, b, n ) ;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// hex numbers
+////////////////////////////////////////////////////////////////////////////////
+
+/// value of each byte as a hex digit, -1 when it is not one
+static const signed char g_hexTable[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+} ;
+
+
+static inline int hexValue( unsigned char c )
+{
+	return g_hexTable[c] ;
+}
+
+
+/// Digits of a number, most significant first, read in place.
+struct HexDigits {
+	const char* s ;
+	size_t n ;		///< digits of the number
+	size_t top ;		///< first significant digit
+	bool le ;
+
+	HexDigits( const char* str, size_t len, bool littleEndian )
+		: s(str), n(0), top(0), le(littleEndian)
+	{
+		while ( n < len && hexValue(s[n]) >= 0 )
+			++n ;
+		if ( le )
+			n &= ~(size_t)1 ;
+		while ( top < n && !(*this)[top] )
+			++top ;
+	}
+	size_t Significant() const { return n - top ; }
+
+	/// digit k, most significant first
+	int operator[]( size_t k ) const
+	{
+		return hexValue( s[ le ? n - 2 - (k & ~(size_t)1) + (k & 1) : k ] ) ;
+	}
+} ;
+
+
+int hexCompare( const char* a, size_t na, const char* b, size_t nb, bool littleEndian )
+{
+	HexDigits x( a, na, littleEndian ) ;
+	HexDigits y( b, nb, littleEndian ) ;
+	if ( x.Significant() != y.Significant() )
+		return x.Significant() < y.Significant() ? -1 : 1 ;
+	for ( size_t i = x.top, j = y.top; i < x.n; ++i, ++j )
+		if ( x[i] != y[j] )
+			return x[i] < y[j] ? -1 : 1 ;
+	return 0 ;
+}
+
+
+std::string hexNumber( const char* s, size_t n, bool littleEndian )
+{
+	static const char digits[] = "0123456789abcdef" ;
+	HexDigits x( s, n, littleEndian ) ;
+	if ( !x.Significant() )
+		return "0" ;
+	std::string out ;
+	out.reserve( x.Significant() ) ;
+	for ( size_t i = x.top; i < x.n; ++i )
+		out += digits[ x[i] ] ;
+	return out ;
+}
+
+
+bool hexToBytes( const char* s, unsigned char* out, size_t n )
+{
+	if ( s[0] == '0' && (s[1] | 0x20) == 'x' )
+		s += 2 ;
+	size_t len = strlen(s) ;
+	if ( !len )
+		return false ;
+	memset( out, 0, n ) ;
+	for ( size_t d = 0; d < len; ++d )
+	{
+		int v = hexValue( s[len - 1 - d] ) ;
+		if ( v < 0 )
+			return false ;
+		if ( d / 2 >= n )
+		{
+			if ( v )
+				return false ;
+			continue ;
+		}
+		out[n - 1 - d/2] |= v << (d & 1 ? 4 : 0) ;
+	}
+	return true ;
+}
+
+
+bool bitsToBytes( const char* s, unsigned char* mask, unsigned char* value, size_t n )
+{
+	size_t len = strlen(s) ;
+	if ( !len )
+		return false ;
+	memset( mask, 0, n ) ;
+	memset( value, 0, n ) ;
+	for ( size_t b = 0; b < len; ++b )
+	{
+		char c = s[len - 1 - b] ;
+		if ( c == 'x' || c == 'X' )
+			continue ;
+		if ( (c != '0' && c != '1') || b / 8 >= n )
+			return false ;
+		unsigned char bit = 1 << (b % 8) ;
+		mask[n - 1 - b/8] |= bit ;
+		if ( c == '1' )
+			value[n - 1 - b/8] |= bit ;
+	}
+	return true ;
+}
+
+
+bool maskEqual( const char* s, size_t n, const unsigned char* mask, const unsigned char* value )
+{
+	size_t i = 0 ;
+	if ( n & 1 )
+	{
+		int v = hexValue( s[0] ) ;
+		if ( v < 0 || ((v ^ *value) & *mask) )
+			return false ;
+		++i, ++mask, ++value ;
+	}
+	for ( ; i < n; i += 2, ++mask, ++value )
+	{
+		int hi = hexValue( s[i] ) ;
+		if ( hi < 0 )
+			return false ;
+		int lo = hexValue( s[i+1] ) ;
+		if ( lo < 0 || (((hi << 4 | lo) ^ *value) & *mask) )
+			return false ;
+	}
+	return true ;
+}
+
+
+size_t hexDecode( const char* s, size_t n, unsigned char* out )
+{
+	size_t i = 0 ;
+	for ( ; i + 1 < n; i += 2 )
+	{
+		int hi = hexValue( s[i] ) ;
+		int lo = hexValue( s[i+1] ) ;
+		if ( (hi | lo) < 0 )
+			break ;
+		*out++ = hi << 4 | lo ;
+	}
+	if ( i < n && hexValue(s[i]) >= 0 )
+	{
+		*out = hexValue(s[i]) << 4 ;
+		return i + 1 ;
+	}
+	return i ;
+}
+
+
+bool maskBytesEqual( const unsigned char* b, size_t n, const unsigned char* mask, const unsigned char* value )
+{
+	for ( size_t i = 0; i < n; ++i )
+		if ( (b[i] ^ value[i]) & mask[i] )
+			return false ;
+	return true ;
+}
+
+
+const char* scanKernels()
+{
+	return kernels().name ;
+}
@@ -0,0 +1,107 @@
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @file Scan.h
+/// @brief Byte scanning kernels of the message handling.
+/// @remarks Each kernel has an AVX2, an SSE2 and a scalar version; the best
+/// one the CPU runs is picked on the first call. The results do not depend
+/// on the version. The hex number helpers are scalar: they stop at the first
+/// digit that differs.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SCAN_NONE	((size_t)-1)
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Split a NUL terminated line in one sweep.
+/// @param s	Line
+/// @param sep	Separator; the position of each one is appended to seps
+/// @param mark	Byte whose last position is returned in lastMark
+/// @param seps	Positions of the separators
+/// @param lastMark	Position of the last mark, SCAN_NONE when there is none
+/// @retval length of the line
+////////////////////////////////////////////////////////////////////////////////
+size_t scanLine( const char* s, char sep, char mark, std::vector<unsigned>& seps, size_t& lastMark ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Position of the first byte equal to a, b or c in s[0..n).
+/// @retval n when there is none
+////////////////////////////////////////////////////////////////////////////////
+size_t scanFirstOf( const char* s, size_t n, char a, char b, char c ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare two hex strings of n bytes, ignoring the case of the letters.
+/// @remarks Whole blocks of 16 or 32 bytes are loaded, the tail byte by byte:
+/// both strings must hold n bytes, a NUL does not end them.
+////////////////////////////////////////////////////////////////////////////////
+bool hexEqual( const char* a, const char* b, size_t n ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare two hex numbers of any width, digit by digit.
+/// @param a,na	First number: the hex digits among its first na bytes
+/// @param b,nb	Second number
+/// @param littleEndian	true when the least significant byte (two digits)
+/// comes first; an odd last digit is then ignored
+/// @retval <0, 0 or >0 as a is lower than, equal to or greater than b
+/// @remarks A number ends at its first byte that is not a hex digit, as with
+/// sscanf("%lx"); leading zeros do not count, so the widths may differ.
+////////////////////////////////////////////////////////////////////////////////
+int hexCompare( const char* a, size_t na, const char* b, size_t nb, bool littleEndian ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A hex number as printf("%lx") writes it: lower case, most
+/// significant digit first, no leading zero.
+/// @see hexCompare for the parameters
+////////////////////////////////////////////////////////////////////////////////
+std::string hexNumber( const char* s, size_t n, bool littleEndian ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a hex number into n bytes, most significant byte first.
+/// @param s	Number, with or without 0x
+/// @retval false when s is not a hex number or does not fit in n bytes
+////////////////////////////////////////////////////////////////////////////////
+bool hexToBytes( const char* s, unsigned char* out, size_t n ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a bit pattern into n mask bytes and n value bytes, most
+/// significant byte first.
+/// @param s	Pattern of 0, 1 and x for a bit that is not checked, most
+/// significant bit first
+/// @retval false on any other character, or when a checked bit does not fit
+/// in n bytes
+////////////////////////////////////////////////////////////////////////////////
+bool bitsToBytes( const char* s, unsigned char* mask, unsigned char* value, size_t n ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Match n hex digits against a mask and a value.
+/// @param s	Digits; the first byte holds a single digit when n is odd
+/// @param mask,value	(n+1)/2 bytes each, the value already masked
+/// @retval true when every bit of the mask has its value; false as well on a
+/// byte that is not a hex digit
+////////////////////////////////////////////////////////////////////////////////
+bool maskEqual( const char* s, size_t n, const unsigned char* mask, const unsigned char* value ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode hex digits into bytes, two digits per byte.
+/// @param s	Digits, n at most; decoding stops at the first other byte
+/// @param out	(n+1)/2 bytes; an odd last digit fills the high half of its byte
+/// @retval number of digits decoded
+////////////////////////////////////////////////////////////////////////////////
+size_t hexDecode( const char* s, size_t n, unsigned char* out ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Match n decoded bytes against a mask and a value.
+/// @see maskEqual
+////////////////////////////////////////////////////////////////////////////////
+bool maskBytesEqual( const unsigned char* b, size_t n, const unsigned char* mask, const unsigned char* value ) ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Name of the kernels in use: "avx2", "sse2" or "scalar".
+////////////////////////////////////////////////////////////////////////////////
+const char* scanKernels() ;
+
+#endif	/* _SCAN_H_ */
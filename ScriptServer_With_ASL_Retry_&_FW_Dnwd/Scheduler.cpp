@@ -0,0 +1,232 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "Scheduler.h"
+
+
+CSendScheduler::CSendScheduler( CReactor& reactor )
+	: m_rReactor(reactor)
+	, m_nTimerFd(-1)
+	, m_bFired(false)
+{
+}
+
+
+CSendScheduler::~CSendScheduler()
+{
+	Close() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create the timer and register it with the reactor.
+/// @retval false when the timerfd could not be created
+////////////////////////////////////////////////////////////////////////////////
+bool CSendScheduler::Open()
+{
+	if ( m_nTimerFd != -1 )
+		return true ;
+	m_nTimerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK ) ;
+	if ( m_nTimerFd == -1 )
+	{
+		LOG_ERROR( "Error - timerfd_create: %s\n", strerror(errno) ) ;
+		return false ;
+	}
+	if ( !m_rReactor.Add(m_nTimerFd, this) )
+	{
+		close( m_nTimerFd ) ;
+		m_nTimerFd = -1 ;
+		return false ;
+	}
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start a loop of sends.
+/// @param sender	Sender name (RF node)
+/// @param rate		Target rate in messages per second; 0 for no limit
+/// @param burst	Messages that may go out back to back
+/// @param jitterUs	Random delay added to every wait for a token, in us
+/// @param reset	Refill the bucket even if its settings did not change
+/// @remarks The loop accounting used by Report() is always restarted.
+////////////////////////////////////////////////////////////////////////////////
+void CSendScheduler::Begin( const char* sender, double rate, unsigned burst, unsigned jitterUs, bool reset )
+{
+	TokenBucket& b = bucket(sender) ;
+	long long now = NowUs() ;
+	if ( !burst ) burst = 1 ;
+	if ( reset || b.rate != rate || b.burst != burst )
+	{
+		b.tokens = burst ;
+		b.lastUs = now ;
+	}
+	b.rate = rate ;
+	b.burst = burst ;
+	b.jitterUs = jitterUs ;
+	b.firstSendUs = b.lastSendUs = 0 ;
+	b.sent = 0 ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait for the next token(s) of a sender.
+/// @param sender	Sender name
+/// @param want		Messages the caller has left to send
+/// @retval number of messages that may be sent now, between 1 and want
+////////////////////////////////////////////////////////////////////////////////
+unsigned CSendScheduler::Acquire( const char* sender, unsigned want )
+{
+	if ( !want )
+		return 0 ;
+	TokenBucket& b = bucket(sender) ;
+	unsigned n = want ;
+	if ( b.rate > 0 )
+	{
+		long long now = NowUs() ;
+		refill( b, now ) ;
+		if ( b.tokens < 1 )
+		{
+			WaitUntil( due(b, now) ) ;
+			refill( b, NowUs() ) ;
+			if ( b.tokens < 1 ) b.tokens = 1 ;
+		}
+		if ( b.tokens < n ) n = (unsigned) b.tokens ;
+		b.tokens -= n ;
+	}
+	b.lastSendUs = NowUs() ;
+	if ( !b.sent ) b.firstSendUs = b.lastSendUs ;
+	b.sent += n ;
+	return n ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait until the sender has a token again, without taking it.
+////////////////////////////////////////////////////////////////////////////////
+void CSendScheduler::Hold( const char* sender )
+{
+	TokenBucket& b = bucket(sender) ;
+	if ( b.rate <= 0 )
+		return ;
+	long long now = NowUs() ;
+	refill( b, now ) ;
+	if ( b.tokens < 1 )
+		WaitUntil( due(b, now) ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Log the achieved and target rates of the last loop of a sender.
+////////////////////////////////////////////////////////////////////////////////
+void CSendScheduler::Report( const char* sender )
+{
+	BucketMap::iterator it = m_oBuckets.find(sender) ;
+	if ( it == m_oBuckets.end() )
+		return ;
+	const TokenBucket& b = it->second ;
+	double achieved = 0 ;
+	if ( b.sent > 1 && b.lastSendUs > b.firstSendUs )
+		achieved = (b.sent - 1) * 1e6 / (b.lastSendUs - b.firstSendUs) ;
+	LOG_INFO( "\tSEND RATE: [node:%s] [sent:%lu] [target:%.3f/s] [achieved:%.3f/s] [burst:%u] [jitter:%uus]\n"
+		, sender, b.sent, b.rate, achieved, b.burst, b.jitterUs ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run the reactor until an absolute time.
+/// @param dueUs	Absolute CLOCK_MONOTONIC time (see NowUs)
+/// @retval false when the timer could not be armed; the wait is then done
+/// with epoll_wait() timeouts only
+////////////////////////////////////////////////////////////////////////////////
+bool CSendScheduler::WaitUntil( long long dueUs )
+{
+	long long now = NowUs() ;
+	if ( dueUs <= now )
+		return true ;
+
+	bool armed = false ;
+	if ( m_nTimerFd != -1 )
+	{
+		struct itimerspec its ;
+		memset( &its, 0, sizeof(its) ) ;
+		its.it_value.tv_sec = dueUs / 1000000 ;
+		its.it_value.tv_nsec = (dueUs % 1000000) * 1000 ;
+		armed = timerfd_settime( m_nTimerFd, TFD_TIMER_ABSTIME, &its, NULL ) == 0 ;
+		if ( !armed )
+			LOG_ERROR( "Error - timerfd_settime: %s\n", strerror(errno) ) ;
+	}
+	m_bFired = false ;
+	while ( !m_bFired && now < dueUs )
+	{
+		/// the timer wakes the reactor up on time; the timeout is only a guard
+		if ( m_rReactor.RunOnce( (int)((dueUs - now) / 1000) + 1 ) < 0 )
+			break ;
+		now = NowUs() ;
+	}
+	return armed ;
+}
+
+
+void CSendScheduler::OnReadable( int fd )
+{
+	unsigned long long expirations ;
+	if ( read(fd, &expirations, sizeof(expirations)) > 0 )
+		m_bFired = true ;
+}
+
+
+void CSendScheduler::Close()
+{
+	if ( m_nTimerFd != -1 )
+	{
+		m_rReactor.Remove( m_nTimerFd ) ;
+		close( m_nTimerFd ) ;
+		m_nTimerFd = -1 ;
+	}
+	for ( BucketMap::iterator it = m_oBuckets.begin(); it != m_oBuckets.end(); ++it )
+		free( (char*)it->first ) ;
+	m_oBuckets.clear() ;
+}
+
+
+long long CSendScheduler::NowUs()
+{
+	struct timespec ts ;
+	clock_gettime( CLOCK_MONOTONIC, &ts ) ;
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 ;
+}
+
+
+TokenBucket& CSendScheduler::bucket( const char* sender )
+{
+	BucketMap::iterator it = m_oBuckets.find(sender) ;
+	if ( it == m_oBuckets.end() )
+	{
+		TokenBucket b ;
+		b.lastUs = NowUs() ;
+		it = m_oBuckets.insert( std::pair<const char*, TokenBucket>(strdup(sender), b) ).first ;
+	}
+	return it->second ;
+}
+
+
+void CSendScheduler::refill( TokenBucket& b, long long nowUs )
+{
+	if ( nowUs > b.lastUs )
+	{
+		b.tokens += (nowUs - b.lastUs) * b.rate / 1e6 ;
+		if ( b.tokens > b.burst ) b.tokens = b.burst ;
+	}
+	b.lastUs = nowUs ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Time the next token of a sender is due, jitter included.
+////////////////////////////////////////////////////////////////////////////////
+long long CSendScheduler::due( const TokenBucket& b, long long nowUs ) const
+{
+	long long waitUs = (long long)((1 - b.tokens) * 1e6 / b.rate) ;
+	if ( waitUs < 0 ) waitUs = 0 ;
+	if ( b.jitterUs )
+		waitUs += rand() % (b.jitterUs + 1) ;
+	return nowUs + waitUs ;
+}
@@ -0,0 +1,66 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <map>
+
+#include "Misc.h"
+#include "Reactor.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Token bucket of one sender.
+/// @remarks rate is in messages per second, 0 for no limit. The first/last
+/// send times and the send count cover the current loop only and give the
+/// achieved rate reported by CSendScheduler::Report().
+////////////////////////////////////////////////////////////////////////////////
+struct TokenBucket {
+	double	rate ;
+	unsigned burst ;
+	unsigned jitterUs ;
+	double	tokens ;
+	long long lastUs ;
+	long long firstSendUs ;
+	long long lastSendUs ;
+	unsigned long sent ;
+	TokenBucket() : rate(0), burst(1), jitterUs(0), tokens(1), lastUs(0)
+		, firstSendUs(0), lastSendUs(0), sent(0) {}
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief timerfd driven send pacing.
+/// @remarks One token bucket is kept per sender (RF node). While a sender
+/// waits for a token, the timer is armed on the absolute time the token is due
+/// and the reactor runs, so the ackLogger ports keep being drained and the
+/// wake up is not bound to the millisecond resolution of epoll_wait().
+////////////////////////////////////////////////////////////////////////////////
+class CSendScheduler : public CReactorHandler {
+public:
+	CSendScheduler( CReactor& reactor ) ;
+	~CSendScheduler() ;
+
+public:
+	bool Open() ;
+	void Begin( const char* sender, double rate, unsigned burst, unsigned jitterUs, bool reset ) ;
+	unsigned Acquire( const char* sender, unsigned want ) ;
+	void Hold( const char* sender ) ;
+	void Report( const char* sender ) ;
+	bool WaitUntil( long long dueUs ) ;
+	void OnReadable( int fd ) ;
+	void Close() ;
+
+	static long long NowUs() ;
+
+protected:
+	typedef std::map<const char*, TokenBucket, cmp_str> BucketMap ;
+	TokenBucket& bucket( const char* sender ) ;
+	void refill( TokenBucket& b, long long nowUs ) ;
+	long long due( const TokenBucket& b, long long nowUs ) const ;
+
+protected:
+	CReactor& m_rReactor ;
+	int	m_nTimerFd ;
+	bool	m_bFired ;
+	BucketMap m_oBuckets ;
+} ;
+
+#endif	/* _SCHEDULER_H_ */
@@ -0,0 +1,199 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ScriptCache.h"
+#include "Flog.h"
+
+#define FNV_OFFSET_BASIS	14695981039346656037ULL
+#define FNV_PRIME		1099511628211ULL
+
+
+CScriptCache::CScriptCache()
+	: m_nKey(FNV_OFFSET_BASIS)
+	, m_pMap(NULL)
+	, m_nMapSize(0)
+{
+}
+
+
+CScriptCache::~CScriptCache()
+{
+	Close() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map the compiled script of an XML file.
+/// @param xmlFile	XML script; the cache is the file of the same name with
+/// the .ssc extension
+/// @param iniFile	Configuration file the script runs with
+/// @param options	Run options the compiled steps depend on
+/// @retval false when there is no cache or it is stale; Store() then
+/// replaces it
+/// @remarks The mapping is private and writable, so that a string used in
+/// place and written to is copied rather than written back.
+////////////////////////////////////////////////////////////////////////////////
+bool CScriptCache::Open( const char* xmlFile, const char* iniFile, unsigned options )
+{
+	Close() ;
+	m_sPath = xmlFile ;
+	size_t dot = m_sPath.rfind('.') ;
+	if ( dot != std::string::npos && m_sPath.find('/', dot) == std::string::npos )
+		m_sPath.erase(dot) ;
+	m_sPath += ".ssc" ;
+
+	m_nKey = FNV_OFFSET_BASIS ;
+	if ( !HashFile(m_nKey, xmlFile) )
+		return false ;
+	HashFile(m_nKey, iniFile) ;
+	Hash(m_nKey, &options, sizeof(options)) ;
+
+	int fd = open( m_sPath.c_str(), O_RDONLY ) ;
+	if ( fd == -1 )
+		return false ;
+	struct stat st ;
+	if ( fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(ScriptCacheHeader) )
+	{
+		close(fd) ;
+		return false ;
+	}
+	m_nMapSize = st.st_size ;
+	m_pMap = mmap( NULL, m_nMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 ) ;
+	close(fd) ;
+	if ( m_pMap == MAP_FAILED )
+	{
+		LOG_ERROR( "Error - mmap %s: %s\n", m_sPath.c_str(), strerror(errno) ) ;
+		m_pMap = NULL ;
+		return false ;
+	}
+
+	const ScriptCacheHeader* h = header() ;
+	if ( h->magic != SCRIPT_CACHE_MAGIC || h->version != SCRIPT_CACHE_VERSION || h->key != m_nKey
+	||   sizeof(*h) + (size_t)h->steps * sizeof(ScriptCacheStep) + (size_t)h->modifies * sizeof(ScriptCacheModify)
+	     + (size_t)h->waits * sizeof(ScriptCacheWait) + h->stringsSize != m_nMapSize
+	||   ( h->stringsSize && strings()[h->stringsSize - 1] != '\0' ) )
+	{
+		LOG_INFO( "Script cache %s is stale\n", m_sPath.c_str() ) ;
+		munmap( m_pMap, m_nMapSize ) ;
+		m_pMap = NULL ;
+		return false ;
+	}
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write the compiled script of the XML file given to Open().
+/// @param steps	Step records
+/// @param modifies	Save/Copy records
+/// @param waits	Wait/Match records
+/// @param strings	String table, see AddString()
+/// @retval false when the cache could not be written; the script still runs
+/// @remarks The file is written aside and renamed, so that a concurrent run
+/// maps either the old or the new cache.
+////////////////////////////////////////////////////////////////////////////////
+bool CScriptCache::Store( const std::vector<ScriptCacheStep>& steps, const std::vector<ScriptCacheModify>& modifies
+	, const std::vector<ScriptCacheWait>& waits, const std::string& strings )
+{
+	if ( m_sPath.empty() )
+		return false ;
+
+	ScriptCacheHeader h ;
+	memset( &h, 0, sizeof(h) ) ;
+	h.magic = SCRIPT_CACHE_MAGIC ;
+	h.version = SCRIPT_CACHE_VERSION ;
+	h.key = m_nKey ;
+	h.steps = steps.size() ;
+	h.modifies = modifies.size() ;
+	h.waits = waits.size() ;
+	h.stringsSize = strings.size() ;
+
+	std::string tmp = m_sPath + ".tmp" ;
+	FILE* f = fopen( tmp.c_str(), "wb" ) ;
+	if ( !f )
+	{
+		LOG_WARN( "Unable to write script cache %s: %s\n", tmp.c_str(), strerror(errno) ) ;
+		return false ;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& ( steps.empty() || fwrite(&steps[0], sizeof(ScriptCacheStep), steps.size(), f) == steps.size() )
+		&& ( modifies.empty() || fwrite(&modifies[0], sizeof(ScriptCacheModify), modifies.size(), f) == modifies.size() )
+		&& ( waits.empty() || fwrite(&waits[0], sizeof(ScriptCacheWait), waits.size(), f) == waits.size() )
+		&& fwrite(strings.data(), 1, strings.size(), f) == strings.size() ;
+	ok = (fclose(f) == 0) && ok ;
+	if ( !ok || rename(tmp.c_str(), m_sPath.c_str()) == -1 )
+	{
+		LOG_WARN( "Unable to write script cache %s: %s\n", m_sPath.c_str(), strerror(errno) ) ;
+		unlink( tmp.c_str() ) ;
+		return false ;
+	}
+	return true ;
+}
+
+
+void CScriptCache::Close()
+{
+	if ( m_pMap )
+	{
+		munmap( m_pMap, m_nMapSize ) ;
+		m_pMap = NULL ;
+	}
+	m_nMapSize = 0 ;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief String of the mapped cache.
+/// @retval NULL for SCRIPT_CACHE_NULL or an offset out of the table
+////////////////////////////////////////////////////////////////////////////////
+char* CScriptCache::String( unsigned int offset ) const
+{
+	if ( !m_pMap || offset >= header()->stringsSize )
+		return NULL ;
+	return strings() + offset ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Append a string to a string table.
+/// @retval offset of the string, SCRIPT_CACHE_NULL for NULL
+////////////////////////////////////////////////////////////////////////////////
+unsigned int CScriptCache::AddString( std::string& strings, const char* s )
+{
+	if ( !s )
+		return SCRIPT_CACHE_NULL ;
+	unsigned int offset = strings.size() ;
+	strings.append( s, strlen(s) + 1 ) ;
+	return offset ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief FNV-1a, 64 bits.
+/// @param h	Hash so far; FNV offset basis for a new hash
+////////////////////////////////////////////////////////////////////////////////
+void CScriptCache::Hash( unsigned long long& h, const void* data, size_t size )
+{
+	const unsigned char* p = (const unsigned char*)data ;
+	for ( size_t i = 0; i < size; ++i )
+	{
+		h ^= p[i] ;
+		h *= FNV_PRIME ;
+	}
+}
+
+
+bool CScriptCache::HashFile( unsigned long long& h, const char* fileName )
+{
+	int fd = open( fileName, O_RDONLY ) ;
+	if ( fd == -1 )
+		return false ;
+	char buf[16*1024] ;
+	ssize_t n ;
+	while ( (n = read(fd, buf, sizeof(buf))) > 0 )
+		Hash( h, buf, n ) ;
+	close(fd) ;
+	return n == 0 ;
+}
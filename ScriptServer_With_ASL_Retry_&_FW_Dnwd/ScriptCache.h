@@ -0,0 +1,151 @@
+#ifndef _SCRIPT_CACHE_H_
+#define _SCRIPT_CACHE_H_
+
+#include <string>
+#include <vector>
+
+/// "SSC1"
+#define SCRIPT_CACHE_MAGIC	0x31435353
+/// bump when the layout of the file or of the step records changes
+/// 2: wait records may end with |mask
+/// 3: compiled step records instead of CSV text
+#define SCRIPT_CACHE_VERSION	3
+/// string offset of a NULL string
+#define SCRIPT_CACHE_NULL	0xFFFFFFFFu
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Header of a compiled script file.
+/// @remarks Followed by the step records, the Save/Copy records, the
+/// Wait/Match records and the string table. Records refer to strings by
+/// their offset in the table and to other records by their index: the file
+/// holds no pointers and can be mapped anywhere. Each record array keeps the
+/// alignment of the next one.
+////////////////////////////////////////////////////////////////////////////////
+struct ScriptCacheHeader {
+	unsigned int magic ;
+	unsigned int version ;
+	unsigned long long key ;	///< FNV-1a of the XML script, ss.ini and the run options
+	unsigned int steps ;
+	unsigned int modifies ;
+	unsigned int waits ;
+	unsigned int stringsSize ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A CompiledStep in the file.
+/// @remarks Its waits, then its saves and copies, are consecutive records.
+////////////////////////////////////////////////////////////////////////////////
+struct ScriptCacheStep {
+	double	loopRate ;
+	int	no ;
+	unsigned int text ;
+	unsigned int desc ;
+	unsigned int rfNode ;	///< name of the RF node, looked up again when loaded
+	int	msgType ;
+	int	timeout ;
+	int	policy ;
+	unsigned int loopText ;
+	int	loopStart ;
+	int	loopEnd ;
+	int	loopIncrement ;
+	int	loopPace ;
+	int	loopBatch ;
+	unsigned int loopBurst ;
+	unsigned int loopJitterUs ;
+	unsigned int outLine ;
+	unsigned int firstWait ;
+	unsigned int waits ;
+	unsigned int firstModify ;
+	unsigned int saves ;
+	unsigned int copies ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A Save or Copy element (TagModify) in the file.
+////////////////////////////////////////////////////////////////////////////////
+struct ScriptCacheModify {
+	long long operand ;
+	int	size ;
+	unsigned int operation ;
+	int	op ;
+	unsigned int id ;	///< interned again when loaded
+	int	src[3] ;	///< Modpos: layer, offset, msgtype
+	int	dst[3] ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A CompiledWait in the file.
+////////////////////////////////////////////////////////////////////////////////
+struct ScriptCacheWait {
+	int	msgType ;
+	int	layer ;
+	int	op ;
+	int	typechk ;
+	int	bitchk ;
+	int	reversechk ;
+	int	offset ;
+	int	size ;
+	unsigned int offsetChar ;
+	unsigned int sizeChar ;
+	unsigned int data ;
+	unsigned int mask ;
+	unsigned int id ;	///< interned again when loaded
+	int	srcSize ;
+	int	src[3] ;
+	unsigned int unboundOffset ;	///< CompiledWait offset, size and data
+	unsigned int unboundSize ;
+	unsigned int unboundData ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compiled script stored next to its XML file.
+/// @remarks Open() maps the cache when its key matches the XML script, ss.ini
+/// and the run options as they are now; the steps are then read from the
+/// records with no XML nor CSV parsing, and the strings are
+/// used where they are mapped. Otherwise the caller compiles the script and
+/// hands the records to Store() for the next runs.
+////////////////////////////////////////////////////////////////////////////////
+class CScriptCache {
+public:
+	CScriptCache() ;
+	~CScriptCache() ;
+
+	bool Open( const char* xmlFile, const char* iniFile, unsigned options ) ;
+	bool Store( const std::vector<ScriptCacheStep>& steps, const std::vector<ScriptCacheModify>& modifies
+		, const std::vector<ScriptCacheWait>& waits, const std::string& strings ) ;
+	void Close() ;
+
+	bool Mapped() const { return m_pMap != NULL ; }
+	unsigned StepCount() const { return m_pMap ? header()->steps : 0 ; }
+	unsigned ModifyCount() const { return m_pMap ? header()->modifies : 0 ; }
+	unsigned WaitCount() const { return m_pMap ? header()->waits : 0 ; }
+	const ScriptCacheStep& Step( unsigned i ) const { return steps()[i] ; }
+	const ScriptCacheModify& Modify( unsigned i ) const { return modifies()[i] ; }
+	const ScriptCacheWait& Wait( unsigned i ) const { return waits()[i] ; }
+	char* String( unsigned int offset ) const ;
+	const char* Path() const { return m_sPath.c_str() ; }
+
+	static unsigned int AddString( std::string& strings, const char* s ) ;
+	static void Hash( unsigned long long& h, const void* data, size_t size ) ;
+	static bool HashFile( unsigned long long& h, const char* fileName ) ;
+
+protected:
+	const ScriptCacheHeader* header() const { return (const ScriptCacheHeader*)m_pMap ; }
+	const ScriptCacheStep* steps() const { return (const ScriptCacheStep*)(header() + 1) ; }
+	const ScriptCacheModify* modifies() const { return (const ScriptCacheModify*)(steps() + header()->steps) ; }
+	const ScriptCacheWait* waits() const { return (const ScriptCacheWait*)(modifies() + header()->modifies) ; }
+	char* strings() const { return (char*)(waits() + header()->waits) ; }
+
+protected:
+	std::string	m_sPath ;
+	unsigned long long m_nKey ;
+	void*	m_pMap ;
+	size_t	m_nMapSize ;
+} ;
+
+#endif	/* _SCRIPT_CACHE_H_ */
@@ -14,16 +14,25 @@
 #include <string.h>
 #include <limits.h>
 #include <deque>
+#include <set>
+#include <algorithm>
 
 #include "Misc.h"
 
 #include "SimpleIni.h"
 #include "ScriptServer.h"
+#include "Scan.h"
+
+/// legacy spacing of looped messages, one every 2 seconds
+#define DEFAULT_LOOP_RATE	0.5
 
 struct RfNode {
 	char* host;
 	int ackLoggerPort;
 	int backbonePort;
+	double rate;		///< send rate limit in msgs/s, 0 for none
+	unsigned burst;
+	unsigned jitterUs;
 };
 std::map<const char*,RfNode,cmp_str> RfNodeMap ;
 
@@ -43,6 +52,8 @@ std::deque<int> taiDesyncQ;
 ////////////////////////////////////////////////////////////////////////////////
 int offset( const enum FIELD_TYPE* lt, const FIELD_TYPE needle )
 {
+	if ( !lt )
+		return -1;		/// no layout for the message type
 	for ( unsigned i=0; lt[i] != INT_MAX; ++i )
 	{
 		if ( lt[i] == needle )
@@ -52,22 +63,6 @@ int offset( const enum FIELD_TYPE* lt, const FIELD_TYPE needle )
 	}
 	return -1;
 }
-char * searchComma( char* dst, int comma)
-{
-	char *pdst = (char*) dst ;
-	for ( int k = 0; k < comma; ++k)
-	{
-		pdst = strchr(pdst, ',') ;
-		if ( !pdst )
-		{
-			LOG_INFO( "Error - Mod(%i):Malformed dst CSV line[%s]\n", k, dst) ;
-			return NULL ;
-		}
-		if ( *pdst == ',' )
-			pdst++ ;
-	}
-	return pdst ;
-}
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Get the type of a message
@@ -114,6 +109,10 @@ char desc1[450]; //Store descreption
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ScriptServer::ScriptServer( )
+	: m_oTransport(m_oReactor)
+	, m_oScheduler(m_oReactor)
+	, m_oConfig(m_oReactor)
+	, m_bRetry(false)
 {
 	placeholderCallbacks["TAIOFFSET"] = &ScriptServer::TaiOffset ;
 	placeholderCallbacks["DIDX"]      = &ScriptServer::didx ;
@@ -121,6 +120,11 @@ ScriptServer::ScriptServer( )
 	placeholderCallbacks["LOAD"]      = &ScriptServer::load ;
 }
 
+ScriptServer::~ScriptServer( )
+{
+	m_oTransport.LogStats() ;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @author sorin bidian
 /// @brief Read data from firmware file and generate XML file containing test messages for UDO
@@ -154,102 +158,23 @@ void ScriptServer::GenerateUdoTest(const char *firmwareFileName, int maxBlockSiz
 //	}
 
 	///make sure that UDO placeholders are present in ss.ini with the expected name
-	CSimpleIniA ini(false, true, true);
-
-	SI_Error rv = ini.LoadFile("../../Config/ss.ini");
-	if (rv != 0) {
-		printf("Config file <ss.ini> not found (err %i)\n", rv);
-		//LOG_ERROR("Config file <ss.ini> not found (err %i)\n", rv);
-		return;
-	}
-
-	bool checkFailed = false;
-
-	const char *p_ss = ini.GetValue("EXPORT", ssIpv6);
-	if(!p_ss) {
-		checkFailed = true; ///"SS_IPV6Add_PORT" key not found in "EXPORT" section
-		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", ssIpv6);
-		//LOG_INFO("The following key has to be defined in ss.ini > [EXPORT] section: SS_IPV6Add_PORT\n");
-	}
-
-	const char *p_dut = ini.GetValue("EXPORT", dutUdoIpv6);
-	if(!p_dut) {
-		checkFailed = true; ///"DUT1_IPV6Add" key not found in "EXPORT" section
-		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", dutUdoIpv6);
-		//LOG_INFO("The following key has to be defined in ss.ini > [EXPORT] section: DUT1_IPV6Add\n");
-	}
-
-	const char *p_node = ini.GetValue("RF_NODES", rfNode);
-	if(!p_node) {
-		checkFailed = true; ///RF_test_point1" key not found in "RF_NODES" section
-		printf("The following key has to be defined in ss.ini > [RF_NODES] section: %s\n", rfNode);
-		//LOG_INFO("The following key has to be defined in ss.ini > [RF_NODES] section: RF_UDO_test_point\n");
-	}
-
-	const char *p_udoPort = ini.GetValue("EXPORT", udoPort);
-	if(!p_udoPort) {
-		checkFailed = true; ///"UDO_port" key not found in "EXPORT" section
-		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", udoPort);
-	}
-
-	const char *p_udoObjectID = ini.GetValue("EXPORT", udoObjectID);
-	if(!p_udoObjectID) {
-		checkFailed = true; ///"UDO_objectID" key not found in "EXPORT" section
-		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", udoObjectID);
-	}
-
-	const char *p_securityPolicy = ini.GetValue("EXPORT", securityPolicy); //securityPolicy is optional; p_securityPolicy has to be checked for NULL when used
-
-	///continue only if we have all needed placeholders defined in config
-	if(checkFailed) {
-		return;
-	}
-
-	///open firmware file - in binary mode
-	TIXML_STRING filename(firmwareFileName);
-
-	FILE* file = TiXmlFOpen(firmwareFileName, "rb");
-	if (!file) {
-		printf("Error: could not open file %s \n", firmwareFileName);
+	UdoConfig cfg ;
+	std::vector<UdoTarget> targets(1, UdoTarget(dutUdoIpv6, rfNode)) ;
+	if ( !readUdoConfig(cfg, targets) ) {
 		return;
 	}
+	const char *p_udoPort = cfg.udoPort.c_str();
+	const char *p_udoObjectID = cfg.udoObjectId.c_str();
+	const char *p_securityPolicy = cfg.securityPolicy.empty() ? NULL : cfg.securityPolicy.c_str(); //securityPolicy is optional
 
-	///get the data size
-	long length = 0;
-	fseek(file, 0, SEEK_END);
-	length = ftell(file) - startOffset;
-	fseek(file, startOffset, SEEK_SET);
-
-	if (length <= 0) {
-		printf("Error in establishing data size \n");
-		fclose(file);
+	///read the firmware file - in binary mode
+	std::vector<unsigned char> buf ;
+	if ( !CUdoDownload::ReadImage(firmwareFileName, startOffset, buf) ) {
 		return;
 	}
-
+	long length = buf.size();
 	printf("File length=%d \n", length);
 
-	unsigned char *buf = new (std::nothrow) unsigned char[length];
-	if (buf == 0) {
-		printf("ERROR memory could not be allocated to buffer the file. File too large: %d \n", length);
-		LOG_INFO("ERROR memory could not be allocated to buffer the file. File too large: %d \n", length);
-		return;
-	}
-	memset(buf, 0, length);
-
-	///copy the data from file into the buffer
-	size_t res = fread( buf, 1, length, file );
-	//size_t res = fread( buf, length, 1, file ); //this reads one element of size=length
-
-	if ( res != length ) {
-		delete [] buf;
-		printf("Reading file error \n");
-		fclose(file);
-		return;
-	}
-
-	///the file can be closed now
-	fclose(file);
-
 	///testing print
 	//	printf("[SORIN] buf:");
 	//	for (int i=0; i < length ; i++) {
@@ -630,7 +555,168 @@ void ScriptServer::GenerateUdoTest(const char *firmwareFileName, int maxBlockSiz
 
 	///finished generating
 	doc.SaveFile("UDOTest.xml");
-	delete [] buf;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read the UDO variables from the configuration file (ss.ini)
+/// @param cfg	Values of the UDO variables
+/// @param targets	DUTs to download to; their address is filled in
+/// @retval false when the configuration file or a mandatory key is missing
+/// @remarks The values come from m_oConfig, loaded here when parseConfig()
+/// has not run yet.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::readUdoConfig(UdoConfig& cfg, std::vector<UdoTarget>& targets) {
+	if (!m_oConfig.Loaded() && !m_oConfig.Load("../../Config/ss.ini")) {
+		printf("Config file <ss.ini> not found\n");
+		return false;
+	}
+
+	bool checkFailed = false;
+
+	const char *p_ss = m_oConfig.Get(ssIpv6);
+	if(!p_ss) {
+		checkFailed = true; ///"SS_IPV6Add_PORT" key not found in "EXPORT" section
+		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", ssIpv6);
+	}
+
+	for (size_t i = 0; i < targets.size(); i++) {
+		const char *p_dut = m_oConfig.Get(targets[i].dutVar.c_str());
+		if(!p_dut) {
+			checkFailed = true; ///"DUT1_IPV6Add" key not found in "EXPORT" section
+			printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", targets[i].dutVar.c_str());
+		} else {
+			targets[i].dutIpv6 = p_dut;
+		}
+
+		const char *p_node = m_oConfig.Get("RF_NODES", targets[i].rfNode.c_str());
+		if(!p_node) {
+			checkFailed = true; ///RF_test_point1" key not found in "RF_NODES" section
+			printf("The following key has to be defined in ss.ini > [RF_NODES] section: %s\n", targets[i].rfNode.c_str());
+		}
+	}
+
+	const char *p_udoPort = m_oConfig.Get(udoPort);
+	if(!p_udoPort) {
+		checkFailed = true; ///"UDO_port" key not found in "EXPORT" section
+		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", udoPort);
+	}
+
+	const char *p_udoObjectID = m_oConfig.Get(udoObjectID);
+	if(!p_udoObjectID) {
+		checkFailed = true; ///"UDO_objectID" key not found in "EXPORT" section
+		printf("The following key has to be defined in ss.ini > [EXPORT] section: %s\n", udoObjectID);
+	}
+
+	const char *p_securityPolicy = m_oConfig.Get(securityPolicy); //securityPolicy is optional
+
+	///continue only if we have all needed placeholders defined in config
+	if(checkFailed) {
+		return false;
+	}
+	cfg.ssIpv6 = p_ss;
+	cfg.dutIpv6 = targets.empty() ? "" : targets[0].dutIpv6;
+	cfg.udoPort = p_udoPort;
+	cfg.udoObjectId = p_udoObjectID;
+	cfg.securityPolicy = p_securityPolicy ? p_securityPolicy : "";
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Download a firmware image to one or more DUTs in process, without generating a script
+/// @param firmwareFileName	Firmware image to be downloaded
+/// @param maxBlockSize		Maximum block size, specified by user
+/// @param startOffset		Offset of the first data block in the firmware file
+/// @param processingTime	Time needed by DUT for processing a block, specified by user
+/// @param window		DownloadData requests kept outstanding per DUT
+/// @param targets		DUT/RF node pairs; the DUT and RF node of GenerateUdoTest() when empty
+/// @retval true when every DUT accepted the new firmware
+/// @remarks The image is read once and shared by all the sessions. The
+/// sessions run together on the reactor, each with its own reqIDs; they must
+/// use distinct RF nodes with distinct ackLogger ports, since a response
+/// carries nothing else to tell the DUTs apart.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::RunUdoDownload(const char *firmwareFileName, int maxBlockSize, int startOffset, int processingTime, int window
+		, std::vector<UdoTarget> targets) {
+	if ( targets.empty() ) {
+		targets.push_back(UdoTarget(dutUdoIpv6, rfNode));
+	}
+	UdoConfig cfg ;
+	std::vector<unsigned char> image ;
+	if ( !m_oReactor.Open() || !readUdoConfig(cfg, targets) || !CUdoDownload::ReadImage(firmwareFileName, startOffset, image) || !parseConfig() ) {
+		return false;
+	}
+
+	std::vector<CUdoDownload*> sessions ;
+	std::set<int> ports ;
+	bool ok = true ;
+	for ( size_t i = 0; ok && i < targets.size(); ++i )
+	{
+		const char *name ;
+		char host[256] ;
+		int ackLoggerPort, backbonePort ;
+		if ( !getRfNode(targets[i].rfNode.c_str(), name, host, ackLoggerPort, backbonePort) ) {
+			ok = false ;
+		} else if ( !ports.insert(ackLoggerPort).second ) {
+			LOG_ERROR("Error - RF_node[%s]: ackLogger port %i already used by another DUT\n", name, ackLoggerPort) ;
+			ok = false ;
+		} else {
+			UdoConfig dut(cfg) ;
+			dut.dutIpv6 = targets[i].dutIpv6 ;
+			sessions.push_back( new CUdoDownload(m_oTransport, name, ackLoggerPort, dut, &image[0], image.size(), maxBlockSize, processingTime, window) ) ;
+		}
+	}
+
+	long long start = CUdpTransport::NowMs() ;
+	for ( size_t i = 0; ok && i < sessions.size(); ++i )
+		sessions[i]->Start() ;
+	while ( ok )
+	{
+		long long deadline = -1 ;
+		for ( size_t i = 0; i < sessions.size(); ++i )
+		{
+			CUdoDownload& s = *sessions[i] ;
+			Datagram d ;
+			while ( !s.Done() && m_oTransport.Pop(s.AckLoggerPort(), d) )
+			{
+				s.OnResponse(d) ;
+				m_oTransport.Release(d) ;
+			}
+			s.Poll() ;
+			if ( !s.Done() && (deadline == -1 || s.NextDeadline() < deadline) )
+				deadline = s.NextDeadline() ;
+		}
+		if ( deadline == -1 )
+			break ;
+		long long left = deadline - CUdpTransport::NowMs() ;
+		if ( m_oReactor.RunOnce( left > 0 ? (int)left : 0 ) == -1 )
+		{
+			for ( size_t i = 0; i < sessions.size(); ++i )
+				if ( !sessions[i]->Done() )
+					sessions[i]->Fail("receive error") ;
+			ok = false ;
+		}
+	}
+
+	if ( sessions.size() > 1 )
+	{
+		unsigned done = 0 ;
+		size_t bytes = 0 ;
+		for ( size_t i = 0; i < sessions.size(); ++i )
+		{
+			bytes += sessions[i]->BytesAcked() ;
+			if ( sessions[i]->Done() && !sessions[i]->Failed() ) ++done ;
+		}
+		long long elapsed = CUdpTransport::NowMs() - start ;
+		LOG_INFO("\tUDO SUMMARY: [sessions:%u] [done:%u] [failed:%u] [bytes:%u] [elapsed:%lldms] [rate:%.0f B/s]\n"
+			, (unsigned)sessions.size(), done, (unsigned)sessions.size() - done, (unsigned)bytes
+			, elapsed, elapsed ? bytes * 1000.0 / elapsed : 0.0) ;
+	}
+	for ( size_t i = 0; i < sessions.size(); ++i )
+	{
+		if ( !sessions[i]->Done() || sessions[i]->Failed() ) ok = false ;
+		delete sessions[i] ;
+	}
+	return ok ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -764,910 +850,1629 @@ void ScriptServer::generateElementsAfterApduUdo(TiXmlElement *msg, const char *s
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Process and run messages from XML file
-/// @param in	Input stream
+/// @param in	Input stream; not read when the cache is mapped
+/// @param cache	Compiled script; the steps are loaded from it when it is
+/// mapped, else stored in it once compiled
 /// @retval error code
+/// @remarks The whole script is parsed and checked by compileScript() before
+/// the first step runs; a malformed step fails the test with no traffic sent.
 ////////////////////////////////////////////////////////////////////////////////
-int ScriptServer::RunScript(std::istream*&in)
+int ScriptServer::RunScript(std::istream* in, CScriptCache& cache)
 {
-	char line[5*1024] = { 0 } ;
-	struct Params params1 ;
-	std::stringstream expandedLine1 ;
-	bool retry = false;
-	
-	parseConfig() ;
+	std::vector<CompiledStep> steps ;
+
+	if ( !m_oReactor.Open() || !parseConfig() )
+	{
+		LOG_INFO("\tTest failed\n") ;
+		return 3 ;
+	}
+	if ( cache.Mapped() ? !loadScript(cache, steps) : !compileScript(*in, steps) )
+	{
+		LOG_INFO("\tTest failed\n") ;
+		return 3 ;
+	}
+	if ( !cache.Mapped() )
+		storeScript(cache, steps) ;
 	LOG_INFO("-----------------------------------------------------------------\n") ;
-	for ( int i = 1;; i++)
+	if ( g_oCfg.Parallel )
+		return runParallel(steps) ;
+
+	for ( size_t k = 0; k < steps.size(); ++k )
 	{
-		char *outLine(NULL), *rmtLine(NULL) ;
+		const CompiledStep& cs = steps[k] ;
+		char *outLine(NULL) ;
+		Datagram rmt ;
+		CMsgView rx ;
 		struct Params params ;
-		int rmtMsgType;
 		int outLineSz;
 
-		in->getline(line, sizeof(line)) ;
-		if ( in->eof() ) return 2 ;
-
-		LOG_INFO( "BeginMessage [%i]\n", i) ;
-		LOG_INFO( "\tREAD CSV: [%s]\n", line) ;
+		LOG_INFO( "BeginMessage [%i]\n", cs.no) ;
+		LOG_INFO( "\tREAD CSV: [%s]\n", cs.text.c_str()) ;
 
-		if ( !readParams(params, line, outLine,outLineSz))
+		if ( !bindStep(cs, params, outLine, outLineSz))
 		{
-			//LOG_INFO("\n RKP: Ln 740\n\n");
 			LOG_INFO("\tTest failed\nEndMessage\n\n") ;
-			//LOG_INFO("\n RKP: Ln 740\n\n");
 			free(outLine);
-			free(rmtLine);
+			m_oTransport.Release(rmt);
 			return 3 ;
 		}
 
-		if ( !wait(params, rmtLine) )
+		if ( !wait(params, rmt, rx) )
 		{
-			if (retry == true)
-			{	
-					LOG_INFO("\n@@@@@@@@@ RKP:RETRY @@@@@@@@@\n");
-					std::string temp = expandedLine1.str().substr(0,expandedLine1.str().length() - 18);
-					expandedLine1.str("");
-					expandedLine1.str().clear();
-					expandedLine1 << temp;
-					sendline(params1, expandedLine1 ) ;
-					retry = false;
-				
+			if ( m_bRetry && resend( m_oLastSent ) )
+			{
+				m_bRetry = false;
 			}
 			else
 			{
 				LOG_INFO("\tTest failed\nEndMessage\n\n") ;
 				free(outLine);
-				free(rmtLine);
+				m_oTransport.Release(rmt);
 				return 3 ;
 			}
-			
-			if ( !wait(params, rmtLine) )
+
+			if ( !wait(params, rmt, rx) )
 			{
-				//LOG_INFO("\n RKP: Ln 740\n\n");
 				LOG_INFO("\tTest failed\nEndMessage\n\n") ;
-				//LOG_INFO("\n RKP: Ln 740\n\n");
 				free(outLine);
-				free(rmtLine);
+				m_oTransport.Release(rmt);
 				return 3 ;
 			}
 		}
 
-		::getMsgType(rmtLine, rmtMsgType/*,false*/);
-		if ( !loadAll(params.LoadVec, rmtLine, outLine, rmtMsgType, params.msgType,outLineSz)
-		|| ( !saveAll(params.StoreVec, rmtLine, params.msgType) ) )
+		int rv = finishStep(params, outLine, outLineSz, rx) ;
+		free(outLine);
+		m_oTransport.Release(rmt);
+		if ( rv )
+			return rv ;
+		LOG_INFO("EndMessage [%i]\n\n", cs.no) ;
+	}
+	return 2 ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply the Copy/Save elements of a step and send its message.
+/// @param params	Message parameters
+/// @param outLine	Message to send; may be resized by the Copy elements
+/// @param outLineSz	Message size
+/// @param rx	Message received for this step; no field when none was received
+/// @retval 0 on success, 4 when Copy/Save could not be applied or the message
+/// could not be sent
+////////////////////////////////////////////////////////////////////////////////
+int ScriptServer::finishStep(Params& params, char*& outLine, int& outLineSz, const CMsgView& rx)
+{
+	if ( !loadAll(params.LoadVec, rx, outLine, params.msgType,outLineSz)
+	|| ( !saveAll(params.StoreVec, rx, params.msgType) ) )
+	{
+		LOG_INFO("\tTest failed\nEndMessage\n\n") ;
+		return 4 ;
+	}
+
+	if ( outLine && *outLine && !(params.policy&POLICY_NOSEND) )
+	{
+		if ( !params.loop.increment ) { params.loop.start=0; params.loop.end=1; }
+		bool sent = params.loop.pace >= 0 ? sendBatched(params, outLine) : sendPaced(params, outLine) ;
+		if ( !sent )
 		{
-			//LOG_INFO("\n RKP: Ln 752\n\n");
 			LOG_INFO("\tTest failed\nEndMessage\n\n") ;
-			//LOG_INFO("\n RKP: Ln 752\n\n");
-			free(outLine);
-			free(rmtLine);
 			return 4 ;
 		}
-
-		if ( outLine && *outLine && !(params.policy&POLICY_NOSEND) )
-		{
-			if ( !params.loop.increment ) { params.loop.start=0; params.loop.end=1; }
-			for ( g_oCfg.loopIdx = params.loop.start
-			    ; g_oCfg.loopIdx < params.loop.end
-			    ; g_oCfg.loopIdx+= params.loop.increment
-			    )
-			{
-				std::stringstream expandedLine ;
-				expandPlaceHolders(outLine, expandedLine ) ;
-				sendline(params, expandedLine ) ;
-				params1 = params;
-				expandedLine1.str("");
-				expandedLine1.str().clear();
-				expandedLine1 << expandedLine.rdbuf();
-				retry = true;
-				if ( params.loop.end-params.loop.start > 1 ) sleep(2) ;
-			}
-		}
-		free(outLine);
-		free(rmtLine);
-		LOG_INFO("EndMessage [%i]\n\n", i) ;
 	}
+	return 0 ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Wait an incoming message from BBR and perform a match on it.
-/// @param params	Message parameters extracted from XML
-/// @param inLine	Message received form BBR
-/// @retval false when matching was unsuccessful
-/// @see match
+/// @brief Send the iterations of a MSG loop at the pace set by the scheduler.
+/// @param params	Message parameters
+/// @param outLine	Message to send, with placeholders
+/// @remarks The rate comes from the MSG loop spec, else from the RF node in
+/// ss.ini. Without either, a loop keeps the legacy spacing of one message every
+/// 2 seconds, the last one included, and single messages are not paced.
+/// Every message is expanded and stamped when its token is granted; tokens
+/// granted together go out in one sendmmsg().
+/// @retval false when a message could not be sent; the rest of the loop is
+/// not sent
 ////////////////////////////////////////////////////////////////////////////////
-bool ScriptServer::wait(Params& params, char*& inLine)
+bool ScriptServer::sendPaced(Params& params, const char* outLine)
 {
-	if ( params.policy&POLICY_NORECV )
-		return true ;
-
-	int s, rv, timeout(params.timeout) ;
-	/**/struct sockaddr_in servaddr, cliaddr ;
-
-	if ( !timeout ) timeout = g_oCfg.DefaultTimeout ;
-
-	/**/if ( (s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1 )
-		diep("socket") ;
+	const struct loop_spec& loop = params.loop ;
+	unsigned count = loop.end > loop.start ? (loop.end - loop.start + loop.increment - 1) / loop.increment : 0 ;
+	const RfNode& node = RfNodeMap[params.rfNode] ;
+	bool legacy = false ;
+	if ( loop.rate > 0 )
+		m_oScheduler.Begin(params.rfNode, loop.rate, loop.burst ? loop.burst : 1, loop.jitterUs, true) ;
+	else if ( node.rate > 0 )
+		m_oScheduler.Begin(params.rfNode, node.rate, node.burst, node.jitterUs, false) ;
+	else
+	{
+		legacy = true ;
+		m_oScheduler.Begin(params.rfNode, count > 1 ? DEFAULT_LOOP_RATE : 0, 1, 0, true) ;
+	}
 
-	inLine = NULL ;
-	struct timeval tv = { timeout, 0 } ;
+	Template tpl ;
+	compileTemplate(outLine, tpl) ;
+	std::stringstream expandedLine ;
+	std::vector<std::string> lines ;
+	g_oCfg.loopIdx = loop.start ;
+	for ( unsigned left = count; left; )
+	{
+		unsigned n = m_oScheduler.Acquire(params.rfNode, left) ;
+		lines.clear() ;
+		for ( unsigned k = 0; k < n; ++k, g_oCfg.loopIdx += loop.increment )
+		{
+			expandedLine.str("") ;
+			expandTemplate(tpl, expandedLine ) ;
+			stampline(expandedLine) ;
+			lines.push_back(expandedLine.str()) ;
+		}
+		left -= n ;
 
-try_again:
-	bzero(&servaddr, sizeof(servaddr)) ;
-	servaddr.sin_family = AF_INET ;
-	servaddr.sin_addr.s_addr = htonl(INADDR_ANY) ;
-	servaddr.sin_port = htons(params.ackLoggerPort) ;
-	bind(s, (struct sockaddr *) &servaddr, sizeof(servaddr)) ;
-        /**/
-	LOG_INFO( "\tWAITING : [host:0.0.0.0] [port:%i] [seconds:%i]\n", params.ackLoggerPort, timeout ) ;
-	//LOG_INFO("\n RKP: Ln:811\n")
-	fd_set rfds ;
-	FD_ZERO(&rfds) ;
-	FD_SET(s,&rfds) ;
-	rv = select(s + 1, &rfds, 0, 0, &tv) ;
-	//printf("\n rv %i \n",rv);
-	//LOG_INFO("\n RKP: Ln:816\n")
-	char mesg[65535] ;
-	if ( rv == -1 )
-	{
-		LOG_INFO( "Error: Select failed\n") ;
-		close(s) ;
-		return false ;
-	} else if ( rv )
-	{
-		memset(mesg, 0, sizeof(mesg) ) ;
-		socklen_t len = sizeof(cliaddr) ;
-		int n = recvfrom(s, mesg, sizeof(mesg) , 0,
-				(struct sockaddr *) &cliaddr, &len) ;
-		mesg[n] = 0 ;
-		if ( mesg[n - 1] == '\n' )
-			mesg[n - 1] = 0 ;
-		char *srcHost = inet_ntoa(cliaddr.sin_addr) ;
-		LOG_INFO( "\tREAD UDP [%s]: [host:%s] [port:%i] [%s]\n", szNow(), srcHost, params.ackLoggerPort, mesg) ;
-		//if ( strcmp(srcHost, params.host) )
-		//{
-		//	LOG_INFO("Error: Test Failed: Received a packet from IP[%s] other than expected[%s]\n", srcHost, params.host ) ;
-		//	close(s) ;
-		//	return false ;
-		//}
-		if ( params.timeout )
-		{
-			updateTAIDesync(mesg); ///keep the TAI desync list updated
-
-			LOG_INFO( "\tMATCHING: ") ;
-			std::vector<struct Tagwait>::iterator it = params.WaitVec.begin() ;
-			for ( ; it != params.WaitVec.end(); ++it)
-			{
-				MATCH_TYPE mt = match(mesg, *it, params.policy) ;
-				if ( MATCH_DROP == mt )
-				{
-					goto try_again ;
-				} else if ( MATCH_FAILED == mt )
-				{
-					close(s) ;
-					return false ;
-				} else if ( MATCH_OK == mt )
-				{
-					continue ;
-				}
-			}
+		int sent = m_oTransport.SendBatch(params.rfNode, lines, 0, n) ;
+		for ( int k = 0; k < sent; ++k )
+			LOG_INFO("\tSENT UDP: [%s]: [host:%s] [port:%d] [%s]\n", szNow(), params.host, params.backbonePort, lines[k].c_str() ) ;
+		if ( sent < 0 || (unsigned)sent < n )
+		{
+			LOG_ERROR("Error - only %i of %u messages sent to RF_node[%s]\n", sent < 0 ? 0 : sent, n, params.rfNode) ;
+			return false ;
 		}
-	} else
-	{
-		//LOG_INFO("\n RKP: Ln:865 Entering Elseb block")
-	if (params.policy&POLICY_WAIT)
+
+		m_oLastSent.params = params ;
+		m_oLastSent.line = lines.back() ;
+		m_oLastSentByNode[params.rfNode] = m_oLastSent ;
+		m_bRetry = true ;
+	}
+	if ( count > 1 )
 	{
-		close(s) ;
-		return true ;
+		if ( legacy )
+			m_oScheduler.Hold(params.rfNode) ;
+		m_oScheduler.Report(params.rfNode) ;
 	}
-else if(params.policy&POLICY_FAILPASS)
-{
-		LOG_INFO( "Response not received in %d seconds as expected\n", timeout ) ;
-		close(s) ;
-		return true ;
-
+	return true ;
 }
-else if(params.policy&POLICY_FAILCONTINUE)
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send the iterations of a MSG loop in batches.
+/// @param params	Message parameters; params.loop holds the pace and batch
+/// @param outLine	Message to send, with placeholders
+/// @retval false when the RF node is unknown or a batch could not be sent
+/// @remarks Batches of params.loop.batch datagrams (the whole loop when 0)
+/// are flushed with sendmmsg() every params.loop.pace ms. Each batch is
+/// expanded and stamped when its turn comes, so that the TAI is the one of its
+/// send. The reactor keeps draining the ackLogger ports meanwhile.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::sendBatched(Params& params, const char* outLine)
 {
-		//LOG_INFO( "\n RKP: Ln:877 \n") ;
-		printf("Params.policy %i",params.policy);
-		LOG_INFO( "No Response in %d seconds \n TEST FAILED\n\n", timeout ) ;
-		//LOG_INFO( "\n RKP: Ln:877 \n") ;
-		close(s) ;
+	const struct loop_spec& loop = params.loop ;
+	unsigned count = loop.end > loop.start ? (loop.end - loop.start + loop.increment - 1) / loop.increment : 0 ;
+	if ( !count )
 		return true ;
 
-}
-else
-{
-		//LOG_INFO( "\n RKP: Ln:882 \n") ;
-		//printf("Params.policy %i",params.policy);
-		LOG_INFO( "Error: No response in %d seconds\n", timeout ) ;
-		//LOG_INFO( "\n RKP: Ln:882 \n") ;
-		close(s) ;
-		return false ;
-}
+	Template tpl ;
+	compileTemplate(outLine, tpl) ;
+	std::stringstream expandedLine ;
+	std::vector<std::string> lines ;
+	unsigned batch = loop.batch > 0 ? (unsigned)loop.batch : count ;
+	long long start = CUdpTransport::NowMs() ;
+	long long next = CSendScheduler::NowUs() ;
+	g_oCfg.loopIdx = loop.start ;
+	for ( unsigned left = count; left; )
+	{
+		unsigned n = std::min(batch, left) ;
+		m_oScheduler.WaitUntil(next) ;
+
+		lines.clear() ;
+		for ( unsigned k = 0; k < n; ++k, g_oCfg.loopIdx += loop.increment )
+		{
+			expandedLine.str("") ;
+			expandTemplate(tpl, expandedLine ) ;
+			stampline(expandedLine) ;
+			lines.push_back(expandedLine.str()) ;
+		}
+		left -= n ;
+
+		int sent = m_oTransport.SendBatch(params.rfNode, lines, 0, n) ;
+		for ( int k = 0; k < sent; ++k )
+			LOG_INFO("\tSENT UDP: [%s]: [host:%s] [port:%d] [%s]\n", szNow(), params.host, params.backbonePort, lines[k].c_str() ) ;
+		if ( sent < 0 || (unsigned)sent < n )
+			return false ;
+		next += (long long)loop.pace * 1000 ;
 	}
-	close(s) ;
-	inLine = strdup(mesg) ;
+	LOG_INFO("\tSENT BATCH: [node:%s] [datagrams:%u] [batch:%u] [pace:%ims] [elapsed:%llims]\n"
+		, params.rfNode, count, batch, loop.pace, CUdpTransport::NowMs() - start ) ;
+
+	m_oLastSent.params = params ;
+	m_oLastSent.line = lines.back() ;
+	m_oLastSentByNode[params.rfNode] = m_oLastSent ;
+	m_bRetry = true ;
 	return true ;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send again a message that was already sent, with a fresh TAI.
+/// @param sent	Message as it was sent, TAI included
+/// @retval false when the message could not be sent
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::resend(SentLine& sent)
+{
+	LOG_INFO("\n@@@@@@@@@ RKP:RETRY @@@@@@@@@\n");
+	std::stringstream line ;
+	line << sent.line.substr(0, sent.line.length() - 18) ;
+	return sendline(m_oTransport, sent.params, line ) ;
+}
 
-#if 0
-int ScriptServer::wait(Params& params, char*& inLine)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Process messages from XML file, running steps addressed to different
+/// RF nodes concurrently.
+/// @param steps	Compiled steps
+/// @retval error code
+/// @remarks Consecutive steps are grouped in a window as long as each one uses
+/// an ackLogger port not yet used in the window. A step with Save elements
+/// closes the window, since the steps that follow may depend on what it saves.
+/// The steps of a window wait at the same time and each one sends its message
+/// as soon as its own response matched; the window ends when all are done.
+////////////////////////////////////////////////////////////////////////////////
+int ScriptServer::runParallel(const std::vector<CompiledStep>& steps)
 {
-		//LOG_INFO( "\n RKP: Ln:905 In Wait2 \n") ;
-	if ( params.policy&POLICY_NORECV )
-	{
-		return true ;
-	}
-	inLine = NULL ;
-	int s, slen, rv, timeout(params.timeout) ;
-	udp( params.host, params.ackLoggerPort);
-	udp.bind(params.ackLoggerPort);
-	poller.add(udp);
-	LOG_INFO( "\tWAITING : [host:0.0.0.0] [port:%i] [seconds:%i]\n", params.ackLoggerPort, timeout ) ;
-	if ( ! poller.isset(udp) )
-	{
-		LOG_INFO( "Error: No response in %d seconds\n", timeout ) ;
-		return false;
-	}
-	udp.read();
-	LOG_INFO( "\tREAD UDP [%s]: [host:%s] [port:%i] [%s]\n", szNow(), srcHost, params.ackLoggerPort, mesg) ;
-	if ( params.timeout )
+	size_t k = 0 ;
+
+	while ( k < steps.size() )
 	{
-		LOG_INFO( "\tMATCHING: ") ;
-		std::vector<struct Tagwait>::iterator it = params.WaitVec.begin() ;
-		for ( ; it != params.WaitVec.end(); ++it)
+		std::vector<Step> window ;
+		std::set<int> ports ;
+		bool saves = false ;
+
+		while ( !saves && k < steps.size() )
 		{
-			MATCH_TYPE mt = match(mesg, *it, params.policy) ;
-			if ( MATCH_DROP == mt )
-			{
-				goto try_again ;
-			} else if ( MATCH_FAILED == mt )
-			{
-				close(s) ;
-				return false ;
-			} else if ( MATCH_OK == mt )
+			const CompiledStep& cs = steps[k] ;
+			if ( !window.empty() && ports.count(cs.ackLoggerPort) )
+				break ;
+			++k ;
+
+			LOG_INFO( "BeginMessage [%i]\n", cs.no) ;
+			LOG_INFO( "\tREAD CSV: [%s]\n", cs.text.c_str()) ;
+
+			Step st ;
+			st.no = cs.no ;
+			if ( !bindStep(cs, st.params, st.outLine, st.outLineSz) )
 			{
-				continue ;
+				LOG_INFO("\tTest failed\nEndMessage\n\n") ;
+				free(st.outLine) ;
+				releaseWindow(window) ;
+				return 3 ;
 			}
+			window.push_back(st) ;
+			ports.insert(cs.ackLoggerPort) ;
+			saves = !cs.saves.empty() ;
 		}
+
+		int rv = runWindow(window) ;
+		releaseWindow(window) ;
+		if ( rv )
+			return rv ;
 	}
+	return 2 ;
 }
-#endif
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Store the desynchronization value between TAI of a RX_RF message and current TAI of the server
-/// @param mesg		Received message
-/// @remarks Values are stored in a list and an average is computed when the TAI_Offset placeholder is called. The list will always contain the latest 3 values.
+/// @brief Run the steps of a window until all of them are done.
+/// @param window	Steps addressed to distinct ackLogger ports
+/// @retval 0 on success, error code of the first failed step otherwise
 ////////////////////////////////////////////////////////////////////////////////
-void ScriptServer::updateTAIDesync(char * mesg) {
-	int type;
-	::getMsgType(mesg,type);
-	if (type == RX_RF) {
-		char *p_tai(mesg);
-		///jump over commas to get TAI value
-		bool err = false;
-		for (int i = 0; i < 8; i++) { //TAI field is after 8 commas
-			if ( ! (p_tai = strchr(p_tai,',')) )
-			{
-				LOG_INFO("Error encountered while getting TAI value from message; (comma=%d)\n", i);
-				err = true;
-				break;
-			}
-			if ( *p_tai == ',' ) p_tai++ ;
+int ScriptServer::runWindow(std::vector<Step>& window)
+{
+	long long now = CUdpTransport::NowMs() ;
+	size_t left = window.size() ;
+
+	for ( size_t k = 0; k < window.size(); ++k )
+	{
+		Step& st = window[k] ;
+		st.timeout = st.params.timeout ? st.params.timeout : g_oCfg.DefaultTimeout ;
+		st.deadline = now + (long long)st.timeout * 1000 ;
+		if ( st.params.policy&POLICY_NORECV )
+		{
+			int rv = completeStep(st) ;
+			if ( rv ) return rv ;
+			--left ;
 		}
-		if (!err) {
-			long taiVal = 0;
-			sscanf(p_tai, "%ld", &taiVal);
-			if (taiVal) {
-				int desync = taiVal - time(NULL) - (0x16925E80 + 34); ///desync between message TAI and current TAI
-				LOG_INFO("\tTAI desync=%d\n", desync);
-				taiDesyncQ.push_back(desync);
-				if (taiDesyncQ.size() > 3) { ///limit storing to 3 values
-					taiDesyncQ.pop_front();
+		else
+			LOG_INFO( "\tWAITING : [step:%i] [host:0.0.0.0] [port:%i] [seconds:%i]\n", st.no, st.params.ackLoggerPort, st.timeout ) ;
+	}
+
+	while ( left )
+	{
+		long long next = 0 ;
+		now = CUdpTransport::NowMs() ;
+		for ( size_t k = 0; k < window.size(); ++k )
+		{
+			Step& st = window[k] ;
+			Datagram d ;
+			bool failed = false ;
+			while ( !st.done && m_oTransport.Pop(st.params.ackLoggerPort, d) )
+			{
+				LOG_INFO( "\tREAD UDP [%s]: [step:%i] [host:%s] [port:%i] [%s]\n", szNow(), st.no,
+					inet_ntoa(d.from.sin_addr), st.params.ackLoggerPort, d.data) ;
+				MATCH_TYPE mt = matchAll(st.params, d, st.rx) ;
+				if ( MATCH_DROP == mt )
+				{
+					m_oTransport.Release(d) ;
+					continue ;
+				}
+				if ( MATCH_FAILED == mt )
+				{
+					m_oTransport.Release(d) ;
+					failed = true ;
+					break ;
 				}
+				st.rmt = d ;
+				int rv = completeStep(st) ;
+				if ( rv ) return rv ;
+				--left ;
+			}
+			if ( st.done )
+				continue ;
+
+			if ( !failed && now < st.deadline )
+			{
+				if ( !next || st.deadline < next ) next = st.deadline ;
+				continue ;
+			}
+
+			if ( !failed && noResponse(st.params, st.timeout) )
+			{
+				st.rx.Parse(NULL) ;
+				int rv = completeStep(st) ;
+				if ( rv ) return rv ;
+				--left ;
+				continue ;
+			}
+			std::map<const char*, SentLine, cmp_str>::iterator last = m_oLastSentByNode.find(st.params.rfNode) ;
+			if ( st.retried || last == m_oLastSentByNode.end() || !resend( last->second ) )
+			{
+				LOG_INFO("\tTest failed [step:%i]\nEndMessage\n\n", st.no) ;
+				return 3 ;
 			}
+			st.retried = true ;
+			st.deadline = now + (long long)st.timeout * 1000 ;
+			if ( !next || st.deadline < next ) next = st.deadline ;
 		}
+		if ( left && m_oReactor.RunOnce( (int)(next - CUdpTransport::NowMs()) ) == -1 )
+			return 3 ;
 	}
+	return 0 ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Perform matching on message data, using Wait/Match parameters extracted from XML
-/// @param p	Message data
-/// @param w	Wait/Match parameters
-/// @param policy	Message policy
-/// @retval	error code
-/// @remarks Used to match by checking for equal
+/// @brief Apply Copy/Save and send the message of a step of a window.
 ////////////////////////////////////////////////////////////////////////////////
-MATCH_TYPE ScriptServer::matchLiteral(const char*p, struct Tagwait&w, int policy)
-{
-char *binary=(char*)malloc(10*sizeof(char));//For storing half byte when bitchk is 1
-if(w.bitchk!=0)//if bit chk is enabled convert half byte to binary
+int ScriptServer::completeStep(Step& st)
 {
-//LOG_INFO( "BITCHECK enabled\n") ;
-//LOG_INFO( "Enabled bch\n") ;
-if(w.size!=1)
-{
-LOG_INFO( "Error: Bit compare only for HALF byte\n") ;
-return MATCH_FAILED ;
+	st.done = true ;
+	int rv = finishStep(st.params, st.outLine, st.outLineSz, st.rx) ;
+	if ( !rv )
+		LOG_INFO("EndMessage [%i]\n\n", st.no) ;
+	return rv ;
 }
-else
+
+
+void ScriptServer::releaseWindow(std::vector<Step>& window)
 {
-//LOG_INFO("\n p=%s",p+w.offset+w.size);
-binary=getBinary(p[w.offset]); // Convert the digit to binary
-binary[4]=0;
-w.size=4;
-}
-}
-	if ( (w.bitchk!=0)?memcmp(binary, w.data, w.size):memcmp(p + w.offset, w.data, w.size) )//If bitchk enabled compare with binary value
+	for ( size_t k = 0; k < window.size(); ++k )
 	{
-    if(w.bitchk!=0)
-       {
- LOG_INFO( "Error: Rsp_wait(l:%u)(o:%i) failed->expecting(%s) != received(%s)\n", w.layer, w.offset, w.data, binary) ;
-       }
-    else
-       {
- LOG_INFO( "Error: Rsp_wait(l:%u)(o:%i) failed->expecting(%s) != received(%s)\n", w.layer, w.offset, w.data, p+w.offset) ;
-       }
-		if ( policy & POLICY_NOMATCH_DROP )
-		{
-			LOG_INFO( "Rsp_wait dropped\n") ;
-			return MATCH_DROP ;
-		}
-	    else if( ( policy & POLICY_WAIT )||( policy & POLICY_FAILCONTINUE )||( policy & POLICY_FAILPASS ))
-		{
-			LOG_INFO( "Rsp_wait dropped\n") ;
-			return MATCH_DROP ;
-		}
-
-	return MATCH_FAILED ;
+		free(window[k].outLine) ;
+		m_oTransport.Release(window[k].rmt) ;
 	}
+	window.clear() ;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait an incoming message from BBR and perform a match on it.
+/// @param params	Message parameters extracted from XML
+/// @param in	Message received form BBR; in.data stays NULL when nothing was received
+/// @param rx	Fields of the message received
+/// @retval false when matching was unsuccessful
+/// @remarks The message is taken from the queue of the ackLogger port, so
+/// responses received while no step was waiting are not lost. The caller
+/// gives the message buffer back with CUdpTransport::Release().
+/// @see runMatch
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::wait(Params& params, Datagram& in, CMsgView& rx)
+{
+	if ( params.policy&POLICY_NORECV )
+		return true ;
 
+	int timeout(params.timeout) ;
+	if ( !timeout ) timeout = g_oCfg.DefaultTimeout ;
 
+	long long deadline = CUdpTransport::NowMs() + (long long)timeout * 1000 ;
+	Datagram d ;
 
+try_again:
+	LOG_INFO( "\tWAITING : [host:0.0.0.0] [port:%i] [seconds:%i]\n", params.ackLoggerPort, timeout ) ;
+	if ( m_oTransport.Receive(params.ackLoggerPort, deadline, d) )
+	{
+		char *srcHost = inet_ntoa(d.from.sin_addr) ;
+		LOG_INFO( "\tREAD UDP [%s]: [host:%s] [port:%i] [%s]\n", szNow(), srcHost, params.ackLoggerPort, d.data) ;
+		MATCH_TYPE mt = matchAll(params, d, rx) ;
+		if ( MATCH_DROP == mt )
+		{
+			m_oTransport.Release(d) ;
+			goto try_again ;
+		} else if ( MATCH_FAILED == mt )
+		{
+			m_oTransport.Release(d) ;
+			return false ;
+		}
+		m_oTransport.Release(in) ;
+		in = d ;
+		return true ;
+	}
+	rx.Parse(NULL) ;	/// not the last message dropped
+	return noResponse(params, timeout) ;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Match a received message against every Wait/Match element of a step.
+/// @param params	Message parameters extracted from XML
+/// @param in		Received message, matched in place in its receive buffer
+/// @param rx		Fields of the received message, split here once for the
+/// match, the TAI desync and the Copy/Save of the step
+/// @retval MATCH_OK when all elements matched or the step does not match
+////////////////////////////////////////////////////////////////////////////////
+MATCH_TYPE ScriptServer::matchAll(Params& params, Datagram& in, CMsgView& rx)
+{
+	rx.Parse(in.data) ;
+	if ( !params.timeout )
+		return MATCH_OK ;
+	if ( !in.len )
+		return MATCH_DROP ;
 
+	updateTAIDesync(rx); ///keep the TAI desync list updated
 
+	LOG_INFO( "\tMATCHING: ") ;
+	return runMatch(params, rx) ;
+}
 
-if(w.typechk==0)//When we dont need to check type constraint
-{
-if ( policy & POLICY_FAILPASS )
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decide the outcome of a step whose response did not arrive in time.
+/// @param params	Message parameters extracted from XML
+/// @param timeout	Seconds waited
+/// @retval true when the step policy accepts a missing response
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::noResponse(Params& params, int timeout)
 {
-	LOG_INFO( "\tWAIT NOT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data, p+w.offset) ;
-	return MATCH_FAILED ;
+	if (params.policy&POLICY_WAIT)
+	{
+		return true ;
+	}
+	else if(params.policy&POLICY_FAILPASS)
+	{
+		LOG_INFO( "Response not received in %d seconds as expected\n", timeout ) ;
+		return true ;
+	}
+	else if(params.policy&POLICY_FAILCONTINUE)
+	{
+		printf("Params.policy %i",params.policy);
+		LOG_INFO( "No Response in %d seconds \n TEST FAILED\n\n", timeout ) ;
+		return true ;
+	}
+	LOG_INFO( "Error: No response in %d seconds\n", timeout ) ;
+	return false ;
 }
-else
-{
-		if(w.bitchk!=0)
+
+
+#if 0
+int ScriptServer::wait(Params& params, char*& inLine)
 {
-	LOG_INFO( "\tWAIT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data,binary) ;
+		//LOG_INFO( "\n RKP: Ln:905 In Wait2 \n") ;
+	if ( params.policy&POLICY_NORECV )
+	{
+		return true ;
+	}
+	inLine = NULL ;
+	int s, slen, rv, timeout(params.timeout) ;
+	udp( params.host, params.ackLoggerPort);
+	udp.bind(params.ackLoggerPort);
+	poller.add(udp);
+	LOG_INFO( "\tWAITING : [host:0.0.0.0] [port:%i] [seconds:%i]\n", params.ackLoggerPort, timeout ) ;
+	if ( ! poller.isset(udp) )
+	{
+		LOG_INFO( "Error: No response in %d seconds\n", timeout ) ;
+		return false;
+	}
+	udp.read();
+	LOG_INFO( "\tREAD UDP [%s]: [host:%s] [port:%i] [%s]\n", szNow(), srcHost, params.ackLoggerPort, mesg) ;
+	if ( params.timeout )
+	{
+		LOG_INFO( "\tMATCHING: ") ;
+		std::vector<struct Tagwait>::iterator it = params.WaitVec.begin() ;
+		for ( ; it != params.WaitVec.end(); ++it)
+		{
+			MATCH_TYPE mt = match(mesg, *it, params.policy) ;
+			if ( MATCH_DROP == mt )
+			{
+				goto try_again ;
+			} else if ( MATCH_FAILED == mt )
+			{
+				close(s) ;
+				return false ;
+			} else if ( MATCH_OK == mt )
+			{
+				continue ;
+			}
+		}
+	}
 }
-else
-{
-	LOG_INFO( "\tWAIT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data, p+w.offset) ;
+#endif
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Store the desynchronization value between TAI of a RX_RF message and current TAI of the server
+/// @param mesg		Received message
+/// @remarks Values are stored in a list and an average is computed when the TAI_Offset placeholder is called. The list will always contain the latest 3 values.
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::updateTAIDesync(const CMsgView& mesg) {
+	if (mesg.Type() == RX_RF) {
+		char *p_tai = mesg.Field(8); //TAI field is after 8 commas
+		bool err = false;
+		if ( !p_tai )
+		{
+			LOG_INFO("Error encountered while getting TAI value from message; (comma=%d)\n", mesg.Fields() - 1);
+			err = true;
+		}
+		if (!err) {
+			long taiVal = 0;
+			sscanf(p_tai, "%ld", &taiVal);
+			if (taiVal) {
+				int desync = taiVal - time(NULL) - (0x16925E80 + 34); ///desync between message TAI and current TAI
+				LOG_INFO("\tTAI desync=%d\n", desync);
+				taiDesyncQ.push_back(desync);
+				if (taiDesyncQ.size() > 3) { ///limit storing to 3 values
+					taiDesyncQ.pop_front();
+				}
+			}
+		}
+	}
 }
-	return MATCH_OK ;
 
-}
-}
-else
+static bool messageOrder(const MatchOp& a, const MatchOp& b)
 {
+	return a.field < b.field || ( a.field == b.field && a.offset < b.offset ) ;
+}
 
-if(memcmp(p+w.offset+w.size,",",1))//Check if the character after expected size is a Comma
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compile the Wait/Match elements of a step into a match program.
+/// @param params	Message parameters; Match is built from WaitVec
+/// @remarks The layer of each element is looked up once here, and the
+/// elements are sorted in the order their data comes in the message. Each
+/// instruction keeps the index of its element, so that the outcome is still
+/// decided and reported in script order. The mask and value of the bitchk
+/// and mask elements are decoded here, once their size is known, and so is
+/// the data of a literal element on whole bytes, to be compared with the
+/// decoded bytes of the message.
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::compileMatch(Params& params)
 {
-LOG_INFO( "\t\nERROR:VALUE RECEIVED BEYOND EXPECTED SIZE: %i\n", w.size) ;
-
-		if ( policy & POLICY_NOMATCH_DROP )//Repeat same policy checks for match drop and failed case
+	MatchProgram& prog = params.Match ;
+	prog.ops.clear() ;
+	prog.bits.clear() ;
+	prog.mixed = false ;
+	prog.msgType = params.WaitVec.empty() ? MSG_UNKNOWN : params.WaitVec[0].msgType ;
+	for ( size_t i = 0; i < params.WaitVec.size(); ++i )
+	{
+		const Tagwait& w = params.WaitVec[i] ;
+		MatchOp op ;
+		op.tag = i ;
+		op.field = offset( MsgLayout[w.msgType], (FIELD_TYPE)w.layer ) ;
+		op.offset = w.offset ;
+		op.bits = -1 ;
+		size_t at = prog.bits.size() ;
+		if ( (w.bitchk || w.mask) && w.data )
 		{
-			LOG_INFO( "Rsp_wait dropped\n") ;
-			return MATCH_DROP ;
+			if ( maskBytes(w, prog.bits) )
+				op.bits = at ;
 		}
-	    else if( ( policy & POLICY_WAIT )||( policy & POLICY_FAILCONTINUE )||( policy & POLICY_FAILPASS ))
+		else if ( w.op == OP_EQ && w.data && w.size > 0 && !(w.size & 1) && !(w.offset & 1)
+			&& strlen(w.data) == (size_t)w.size )
 		{
-			LOG_INFO( "Rsp_wait dropped\n") ;
-			return MATCH_DROP ;
+			prog.bits.resize( at + w.size / 2 ) ;
+			if ( ::hexDecode(w.data, w.size, &prog.bits[at]) == (size_t)w.size )
+				op.bits = at ;
+			else
+				prog.bits.resize(at) ;
 		}
+		prog.ops.push_back(op) ;
+		if ( w.msgType != prog.msgType )
+			prog.mixed = true ;
+	}
+	std::stable_sort( prog.ops.begin(), prog.ops.end(), messageOrder ) ;
+}
 
-	return MATCH_FAILED ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Match a received message against the match program of a step.
+/// @param params	Message parameters
+/// @param rx		Fields of the received message
+/// @retval outcome of the first element, in script order, that does not
+/// match; MATCH_OK when all of them match
+/// @remarks The message type is checked once. The elements are then checked
+/// in a single forward pass over the message, without logging; an element
+/// coming after the first failure found so far is skipped. Only then are the
+/// elements logged, in script order, up to the first failure.
+////////////////////////////////////////////////////////////////////////////////
+MATCH_TYPE ScriptServer::runMatch(Params& params, const CMsgView& rx)
+{
+	const MatchProgram& prog = params.Match ;
+	size_t n = prog.ops.size() ;
+	if ( !n )
+		return MATCH_OK ;
+	if ( m_vMatchEval.size() < n )
+		m_vMatchEval.resize(n) ;
 
+	size_t first = n ;
+	if ( !prog.mixed && rx.Type() != prog.msgType )
+	{
+		/// the first element fails, on its layer or operator if not on the type
+		const Tagwait& w = params.WaitVec[0] ;
+		evalWait(w, offset(MsgLayout[w.msgType], (FIELD_TYPE)w.layer), NULL, rx, m_vMatchEval[0]) ;
+		first = 0 ;
+	}
+	for ( size_t k = 0; k < n && first; ++k )
+	{
+		const MatchOp& op = prog.ops[k] ;
+		if ( op.tag > first )
+			continue ;
+		const Tagwait& w = params.WaitVec[op.tag] ;
+		MatchEval& e = m_vMatchEval[op.tag] ;
+		const unsigned char* bits = op.bits < 0 ? NULL : &prog.bits[op.bits] ;
+		if ( outcome(w, evalWait(w, op.field, bits, rx, e), params.policy) != MATCH_OK )
+			first = op.tag ;
+	}
+
+	size_t last = first < n ? first : n - 1 ;
+	for ( size_t k = 0; k < last; ++k )
+		reportWait(params.WaitVec[k], rx, m_vMatchEval[k], params.policy) ;
+	return reportWait(params.WaitVec[last], rx, m_vMatchEval[last], params.policy) ;
 }
-else// There is no character beyond expected size
-{
-if ( policy & POLICY_FAILPASS )
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check a Wait/Match element against a received message, silently.
+/// @param w	Wait/Match parameters
+/// @param field	Commas before the layer of the element
+/// @param bits	Mask then value bytes of a bitchk or mask element, NULL
+/// when they do not fit its size; bytes of the data of a literal element,
+/// NULL when it is not made of whole bytes
+/// @param rx	Fields of the received message
+/// @param e	Check, with the details kept for reportWait()
+/// @retval MATCH_CHECK
+////////////////////////////////////////////////////////////////////////////////
+int ScriptServer::evalWait(const Tagwait& w, int field, const unsigned char* bits, const CMsgView& rx, MatchEval& e)
 {
-	LOG_INFO( "\tWAIT NOT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data, p+w.offset) ;
-	return MATCH_FAILED ;
+	e.field = field ;
+	e.bits = bits ;
+	return e.check = checkWait(w, rx, e) ;
 }
-else
+
+
+int ScriptServer::checkWait(const Tagwait& w, const CMsgView& rx, MatchEval& e)
 {
-	LOG_INFO( "\tWAIT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data, p+w.offset) ;
-	return MATCH_OK ;
+	int field = e.field ;
+	if ( -1 == field ) return CHECK_LAYER ;
+	if ( w.op == OP_UNKNOWN ) return CHECK_OP ;
+	if ( w.msgType != rx.Type() ) return CHECK_TYPE ;
+
+	/* The selected layer starts after field commas. */
+	e.p = rx.Field(field) ;
+	if ( !e.p ) return CHECK_MALFORMED ;
+
+	/* received messages seldom hold placeholders: compare in place then,
+	 * on the decoded bytes of the layer when the element spans whole bytes */
+	const unsigned char* rcv = NULL ;
+	size_t digits = 0 ;
+	if ( !rx.Placeholders(e.p) )
+	{
+		if ( e.bits && !(w.offset & 1) && !(w.size & 1) )
+			rcv = rx.Bytes(field, digits) ;
+	}
+	else
+	{
+		std::stringstream expandedLine ;
+		expandPlaceHolders(e.p, expandedLine ) ;
+		e.expanded = expandedLine.str() ;
+		e.p = e.expanded.c_str() ;
+	}
 
+	if ( w.op != OP_EQ )
+	{
+		/* numbers of any width, little endian with reversechk like the data */
+		int cmp = ::hexCompare( e.p + w.offset, w.size, w.data, w.size, w.reversechk ) ;
+		if ( (w.op == OP_LT && cmp < 0)
+		||   (w.op == OP_LE && cmp <= 0)
+		||   (w.op == OP_GT && cmp > 0)
+		||   (w.op == OP_GE && cmp >= 0) )
+			return CHECK_OK ;
+		return CHECK_DIFF ;
+	}
+
+	/* a digit that is not hex in the received span never matches; hexEqual()
+	 * reads whole blocks, so a layer ending before the span is left out first */
+	size_t end = w.offset + w.size ;
+	if ( rcv ? digits < end
+		 : (e.p == e.expanded.c_str() ? e.expanded.length() : strnlen(e.p, end)) < end )
+		return CHECK_DIFF ;
+	size_t n = ( w.size + 1 ) / 2 ;
+	if ( w.bitchk || w.mask )
+	{
+		if ( !e.bits )
+			return CHECK_BITSIZE ;
+		if ( rcv ? !::maskBytesEqual(rcv + w.offset / 2, n, e.bits, e.bits + n)
+			 : !::maskEqual(e.p + w.offset, w.size, e.bits, e.bits + n) )
+			return CHECK_DIFF ;
+	}
+	else if ( rcv ? memcmp(rcv + w.offset / 2, e.bits, n)
+		      : !::hexEqual(e.p + w.offset, w.data, w.size) )	// hex digits, either case
+		return CHECK_DIFF ;
+
+	if ( w.typechk && e.p[w.offset + w.size] != ',' ) //Check if the character after expected size is a Comma
+		return CHECK_BEYOND ;
+	return CHECK_OK ;
 }
-}
-}
-}//}}}
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Perform matching on message data, using Wait/Match parameters extracted from XML.
-/// @param p	Message data
-/// @param w	Wait/Match parameters
-/// @param policy	Message policy
-/// @retval	error code
-/// @remarks Used to compare native types
+/// @brief Outcome of the check of a Wait/Match element under the step policy.
+/// @remarks With failpass an element that matches is a failure.
 ////////////////////////////////////////////////////////////////////////////////
-MATCH_TYPE ScriptServer::matchNativeType(const char *p, Tagwait& w, int policy)
+MATCH_TYPE ScriptServer::outcome(const Tagwait& w, int check, int policy)
 {
-	if ( w.size > 4 ) /* we cant handle native types larger than 4 bytes */
+	bool drop = policy & (POLICY_NOMATCH_DROP|POLICY_WAIT|POLICY_FAILCONTINUE|POLICY_FAILPASS) ;
+	switch ( check )
 	{
-		LOG_INFO("Error: Unable to compare data larger than 4 bytes") ;
+	case CHECK_OK:
+		if ( w.op != OP_EQ ) return MATCH_OK ;
+		return (policy & POLICY_FAILPASS) ? MATCH_FAILED : MATCH_OK ;
+	case CHECK_TYPE:
+		return drop ? MATCH_DROP : MATCH_FAILED ;
+	case CHECK_DIFF:
+	case CHECK_BEYOND:
+		if ( w.op != OP_EQ ) return MATCH_FAILED ;
+		return drop ? MATCH_DROP : MATCH_FAILED ;
+	default:
 		return MATCH_FAILED ;
 	}
-	unsigned long oprd1(0), oprd2(0) ;
-	char buf[8];
-
-	memcpy(buf, p + w.offset, w.size) ;
-	buf[w.size]=0;
-	sscanf( buf, "%lx", &oprd1 ) ;
-
-	memcpy( buf, w.data, w.size) ;
-	buf[w.size]=0;
-	sscanf( buf, "%lx", &oprd2 ) ;
+}
 
-	if ( (w.op == OP_LT && oprd1 < oprd2)
-	||   (w.op == OP_LE && oprd1  <= oprd2)
-	||   (w.op == OP_GT && oprd1 > oprd2)
-	||   (w.op == OP_GE && oprd1 >= oprd2) )
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bits of n hex digits, four per digit, for the log of a bitchk element.
+////////////////////////////////////////////////////////////////////////////////
+static std::string bitsOf(const char* digits, int n)
+{
+	std::string bits ;
+	for ( int i = 0; i < n && digits[i]; ++i )
 	{
-	LOG_INFO("compare OK: %lx %lx\n", oprd1, oprd2);
-		return MATCH_OK ;
+		char c = digits[i] | 0x20 ;
+		int v = isdigit(c) ? c - '0' : ( c >= 'a' && c <= 'f' ) ? c - 'a' + 10 : -1 ;
+		for ( int b = 3; b >= 0; --b )
+			bits += v < 0 ? '?' : (v >> b & 1) + '0' ;
 	}
-	LOG_INFO("compare failed: %lx %lx\n", oprd1, oprd2);
-	return MATCH_FAILED ;
+	return bits ;
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Perform matching on message received from BBR, using Wait/Match parameters extracted from XML
-/// @param mesg		Received message
-/// @param params	Wait/Match parameters
+/// @brief Log the check of a Wait/Match element.
+/// @param w	Wait/Match parameters
+/// @param rx	Fields of the received message
+/// @param e	Check made by evalWait()
 /// @param policy	Message policy
-/// @retval	error code
+/// @retval outcome of the check
 ////////////////////////////////////////////////////////////////////////////////
-MATCH_TYPE ScriptServer::match(char * mesg, struct Tagwait& cmp, int policy)
+MATCH_TYPE ScriptServer::reportWait(const Tagwait& w, const CMsgView& rx, const MatchEval& e, int policy)
 {
-	int nbCommas = offset( MsgLayout[cmp.msgType], (FIELD_TYPE)cmp.layer ) ;
-	if ( -1 == nbCommas )
+	MATCH_TYPE mt = outcome(w, e.check, policy) ;
+	switch ( e.check )
 	{
-		LOG_ERROR( "Unknown layer/msg:%i \n", cmp.layer );
-		return MATCH_FAILED ;
+	case CHECK_LAYER:
+		LOG_ERROR( "Unknown layer/msg:%i \n", w.layer );
+		return mt ;
+	case CHECK_OP:
+		return mt ;
+	case CHECK_TYPE:
+		if ( mt == MATCH_FAILED )
+			LOG_INFO("Error: Unexpected message type. I was waiting for[%s]\n", getMsgType(w.msgType) );
+		return mt ;
+	case CHECK_MALFORMED:
+		LOG_INFO( "Error: Malformed CSV line[%s][%i][%i]\n", rx.Data(), e.field, w.layer) ;
+		return mt ;
 	}
-	char *p(mesg) ;
-	/* preconditions */
-	if ( cmp.op == OP_UNKNOWN ) return MATCH_FAILED ;
-
-	int type;
-	::getMsgType(mesg,type);
 
-	/* Verify the expected message type. */
-	if ( cmp.msgType != type )
+	if ( w.op != OP_EQ )
 	{
-		if (policy&POLICY_NOMATCH_DROP)
+		LOG_INFO("native\n");
+		std::string rcv = ::hexNumber( e.p + w.offset, w.size, w.reversechk ) ;
+		std::string expected = ::hexNumber( w.data, w.size, w.reversechk ) ;
+		if ( e.check == CHECK_OK )
+		{
+			LOG_INFO("compare OK: %s %s\n", rcv.c_str(), expected.c_str());
+		}
+		else
 		{
-			return MATCH_DROP;
+			LOG_INFO("compare failed: %s %s\n", rcv.c_str(), expected.c_str());
 		}
+		return mt ;
+	}
 
-	else if (policy&POLICY_WAIT)
+	const char* received = e.p + w.offset ;
+	std::string bits ;
+	if ( w.bitchk )
+	{
+		bits = bitsOf(received, w.size) ;
+	}
+	switch ( e.check )
+	{
+	case CHECK_BITSIZE:
+		LOG_INFO( "Error: %s [%s] does not fit size %i\n", w.bitchk ? "Bit pattern" : "Mask/value", w.data, w.size) ;
+		break ;
+	case CHECK_DIFF:
+		if ( w.mask )
 		{
-			return MATCH_DROP;
+			LOG_INFO( "Error: Rsp_wait(l:%u)(o:%i) failed->expecting(%s mask %s) != received(%.*s)\n", w.layer, w.offset
+				, w.data, w.mask, w.size, received) ;
 		}
-	else if (policy&POLICY_FAILPASS)
+		else
 		{
-			return MATCH_DROP;
+			LOG_INFO( "Error: Rsp_wait(l:%u)(o:%i) failed->expecting(%s) != received(%s)\n", w.layer, w.offset, w.data
+				, w.bitchk ? bits.c_str() : received) ;
 		}
-       else if (policy&POLICY_FAILCONTINUE)
+		break ;
+	case CHECK_BEYOND:
+		LOG_INFO( "\t\nERROR:VALUE RECEIVED BEYOND EXPECTED SIZE: %i\n", w.bitchk ? 4 * w.size : w.size) ;
+		break ;
+	default:
+		if ( policy & POLICY_FAILPASS )
 		{
-			return MATCH_DROP;
+			LOG_INFO( "\tWAIT NOT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data, received) ;
 		}
 		else
 		{
-			LOG_INFO("Error: Unexpected message type. I was waiting for[%s]\n", getMsgType(cmp.msgType) );
-			return MATCH_FAILED ;
+			LOG_INFO( "\tWAIT ok(l:%u)(o:%i) [%s] == [%s]\n", w.layer, w.offset, w.data
+				, w.bitchk && !w.typechk ? bits.c_str() : received) ;
 		}
+		return mt ;
 	}
+	if ( mt == MATCH_DROP )
+		LOG_INFO( "Rsp_wait dropped\n") ;
+	return mt ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Resolve a Match offset or size written as a placeholder.
+/// @param spec	Field as written: {NAME} or {N+NAME}
+/// @param expanded	Expanded placeholder, allocated
+/// @retval value of the placeholder plus the constant
+////////////////////////////////////////////////////////////////////////////////
+int ScriptServer::resolveInt(const char* spec, char*& expanded)
+{
+	int Cnst = 0;
+	std::string placeholder = intPlaceholder(spec, Cnst) ;
 
-	/* Jump over commas until the selected layer is found. */
-	for ( int i = 0; i < nbCommas; ++i)
+	std::stringstream os ;
+	expandPlaceHolders(placeholder.c_str(),os);
+	expanded = strdup( os.str().c_str() );
+	return atoi(expanded) + Cnst ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Split a Match offset or size written as {N+NAME}.
+/// @param spec	Field as written: {NAME} or {N+NAME}
+/// @param Cnst	N, 0 when there is none
+/// @retval the placeholder alone: {NAME}
+////////////////////////////////////////////////////////////////////////////////
+std::string ScriptServer::intPlaceholder(const char* spec, int& Cnst)
+{
+	int i=0,j=1,k=0;
+	char val_ch[5];
+	char Tmp[30];
+	int OperatorFlag = 0;
+	Cnst = 0;
+	Tmp[0]='{';
+
+	/*Logic is modified by HONEYWELL *//* RK PRAVEEN*/
+	while(spec[i] != '}')
 	{
-		if ( ! (p=strchr(p,',')) )
+		if((spec[i]>= 48 && spec[i] < 58) && (OperatorFlag == 0))
+		{
+			val_ch[k]= spec[i];
+			k++;
+		}
+		else if(spec[i]>= 65 && spec[i]<=122)
+		{
+			Tmp[j] = spec[i];
+			j++;
+		}
+		else if(spec[i] == '+')
 		{
-			LOG_INFO( "Error: Malformed CSV line[%s][%i][%i]\n",mesg, nbCommas, cmp.layer) ;
-			return MATCH_FAILED ;
+			OperatorFlag = 1;
+			val_ch[k] = '\0';
 		}
-		if ( *p == ',' ) p++ ;
+		i++;
 	}
+	Tmp[j]='}';
+	Tmp[++j]='\0';
 
-	std::stringstream expandedLine ;
-	expandPlaceHolders(p, expandedLine ) ;
-	/* compare */
-	if ( cmp.op == OP_EQ ) { return matchLiteral(expandedLine.str().c_str(),cmp,policy) ; }
-	LOG_INFO("native\n");
-	return matchNativeType(expandedLine.str().c_str(),cmp,policy);
+	if(OperatorFlag == 1)
+		Cnst = atoi(val_ch);
+	return Tmp ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Get message parameters specified in XML
-/// @param params	Parameters extracted from message
-/// @param line		Message string
-/// @param outLine	Remaining string after parameters reading
-/// @param outLineSz	Remaining string size
-/// @retval	true when parameters are sucessfully read
+/// @brief Resolve at load time a Match offset or size whose placeholder is pure.
+/// @param spec	Field as written: {NAME} or {N+NAME}
+/// @param value	Value of the field
+/// @param expanded	Expanded placeholder, allocated
+/// @retval false when the placeholder is dynamic; bindStep() resolves it
 ////////////////////////////////////////////////////////////////////////////////
-bool ScriptServer::readParams(struct Params& params, char *line, char *& outLine, int& outLineSz)
+bool ScriptServer::foldInt(const char* spec, int& value, char*& expanded)
 {
-	if ( NULL==line || 0==line[0] ) return false;
-
-	std::string op ; //To get value each time
-	CCsv c1, c3 ;
+	int Cnst = 0 ;
+	std::string folded ;
+	if ( foldPlaceHolders(intPlaceholder(spec, Cnst).c_str(), folded) )
+		return false ;
+	expanded = strdup( folded.c_str() ) ;
+	value = atoi(expanded) + Cnst ;
+	return true ;
+}
 
-	std::stringstream out ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse all the steps of a script and check them before any is run.
+/// @param in	CSV steps, one per line
+/// @param steps	Parsed steps
+/// @retval false when a step is malformed; every error is logged, not only
+/// the first one
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::compileScript(std::istream& in, std::vector<CompiledStep>& steps)
+{
+	std::set<std::string> saved ;
+	std::string line ;
+	int errors = 0 ;
 
-	c1.SetLine(line).SetSeparator(':',',') ;
-	c1.Get(op) ; // rfNode
-int i=0;
-	while(op[i]!='\0') //Change to Upper Case
+	for ( int i = 1; std::getline(in, line); ++i )
 	{
-		if(op[i]>=97) op[i]-=32;
-		i++;
+		steps.push_back( CompiledStep() ) ;
+		if ( !compileStep(steps.back(), i, line, saved) )
+			++errors ;
+	}
+	if ( errors )
+	{
+		LOG_ERROR("Error - %i of %u steps are invalid, the script is not run\n", errors, (unsigned)steps.size()) ;
+		return false ;
 	}
-	params.desc=(char*)op.c_str();
-	int t=strlen(params.desc);
-	strcpy(desc1,params.desc);
-	desc1[t]='\0';
+	LOG_INFO("Script loaded: %u steps\n", (unsigned)steps.size()) ;
+	return true ;
+}
 
-	//unsigned char ch[10];
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a CSV step and check it against the message layouts, the RF
+/// nodes and the ids saved by the steps before it.
+/// @param cs	Parsed step
+/// @param no	Step number
+/// @param line	CSV step
+/// @param saved	Ids saved by the previous steps; the ids this step saves are added.
+/// The ids loaded from the -s snapshot count as saved as well.
+/// @retval false when the step is malformed
+/// @remarks The pure placeholders (see isPure()) are substituted here. Offsets,
+/// sizes and data still holding placeholders, and data compared to a saved
+/// id, are kept and resolved by bindStep().
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::compileStep(CompiledStep& cs, int no, const std::string& line, std::set<std::string>& saved)
+{
+	bool ok = true ;
+	cs.no = no ;
+	cs.text = line ;
+	if ( line.empty() )
+	{
+		LOG_ERROR("Error - step %i: empty step\n", no) ;
+		return false ;
+	}
 
-	LOG_INFO("\n-------MESSAGE  DESCREPTION: %s--------- \n\n", params.desc);
+	std::string op ;
+	CCsv c1, c3 ;
+	c1.SetLine(line.c_str()).SetSeparator(':',',') ;
 
-	c1.Get(op) ; // rfNode
+	c1.Get(cs.desc) ;
+	for ( size_t i = 0; i < cs.desc.size(); ++i )	//Change to Upper Case
+		if ( cs.desc[i] >= 97 ) cs.desc[i] -= 32 ;
 
-	if ( !getRfNode(op.c_str(), params.host, params.ackLoggerPort, params.backbonePort) )
-		return false ;
+	c1.Get(op) ;
+	if ( !getRfNode(op.c_str(), cs.rfNode, cs.host, cs.ackLoggerPort, cs.backbonePort) )
+	{
+		LOG_ERROR("Error - step %i: unknown RF node [%s]\n", no, op.c_str()) ;
+		ok = false ;
+	}
 
-	/* Read message type */
-	c1.Get(op).Get(params.timeout) ;
-	LOG_INFO("\tOPTIONS : [host:%s] [timeout:%d] \n", params.host, params.timeout) ;
-//LOG_INFO("\nparams.msgType:%s\n",op.c_str());
-	::getMsgType(op.c_str(), params.msgType) ;
-//LOG_INFO("After calling1\n");
+	c1.Get(op).Get(cs.timeout) ;
+	if ( !::getMsgType(op.c_str(), cs.msgType) && !op.empty() )
+	{
+		LOG_ERROR("Error - step %i: unknown message type [%s]\n", no, op.c_str()) ;
+		ok = false ;
+	}
 
-	/* Read policy */
 	c1.Get(op) ;
-	getPolicyType(op.c_str(), params.policy) ;
+	if ( !getPolicyType(op.c_str(), cs.policy) && !op.empty() )
+	{
+		LOG_ERROR("Error - step %i: unknown policy [%s]\n", no, op.c_str()) ;
+		ok = false ;
+	}
 
-	/* Read loop */
+	/// a loop holding dynamic placeholders is expanded when the step runs
 	c1.Get(op) ;
-	getLoop(op.c_str(), params.loop);
+	if ( !foldPlaceHolders(op.c_str(), cs.loopText) )
+	{
+		getLoop(cs.loopText.c_str(), cs.loop) ;
+		cs.loopText.clear() ;
+	}
 
 	/* Read Wait/Match */
-	std::string waits ;
+	const char* rec ;	///< element being read, a view into line
+	size_t recLen ;
 	while ( !c1.Eor() )
 	{
-		c1.Get(waits) ;
-		if ( waits == "" )
+		c1.Get(rec, recLen) ;
+		if ( !recLen )
 			break ;
 
-		c3.SetLine(waits.c_str()).SetSeparator('|') ;
-
-		struct Tagwait w ;
-		/* Read message operator*/
-		getOpType( c3, w.op) ;
-              c3.Get(w.typechk);// Get type check value
-              c3.Get(w.bitchk);// Get bit check value
-	       c3.Get(w.reversechk);// Get bit check value
-
-		c3.Get(w.id) ;//Get id to compare saved Data
-		if ( *w.id == '\0' )
-		{
-			free(w.id) ;
-			w.id = NULL ;
-		}
-		//LOG_INFO("\nTypech=%i Bitchk=%i id=%s\n",w.typechk,w.bitchk,w.id);
-		getLayerType( c3, w.src.layer) ; //For stored id
-		c3.Get(w.src.offset) ; //For stored id
-              c3.Get(w.srcSize); // For stored id
-		
-		/* Read message type */
-		::getMsgType( c3, w.msgType) ;
-		//LOG_INFO("After calling 2\n");
-
-		/* Read layer name */
-		getLayerType( c3, w.layer) ;
-
-		/* Read offset, size and data */
-		char* data;
-		
-		char* size_char;
-		char* offset_char;
-			
-		/*Logic is modified by HONEYWELL *//* RK PRAVEEN*/
-		c3.Get(offset_char).Get(size_char).Get(data) ;
-		
-		int i =0,j=1,k=0;
-		char val_ch[5];
-		char Tmp[30];
-		int OperatorFlag = 0;
-		int Cnst = 0;
-		Tmp[0]='{';
-		
-		if(offset_char[0] != '{')
-		{
-			
-			w.offset = atoi(offset_char);
-			
-		}
-		
-		else
+		c3.SetLine(rec, recLen).SetSeparator('|') ;
+
+		CompiledWait cw ;
+		memset( &cw, 0, sizeof(cw) ) ;
+		Tagwait& w = cw.w ;
+
+		c3.Get(op) ;
+		if ( !getOpType(op.c_str(), w.op) )
+		{
+			LOG_ERROR("Error - step %i: unknown match operator [%s]\n", no, op.c_str()) ;
+			ok = false ;
+		}
+		c3.Get(w.typechk).Get(w.bitchk).Get(w.reversechk) ;
+
+		c3.Get(op) ;	//id to compare saved Data
+		w.slot = -1 ;
+		if ( !op.empty() )
 		{
-		
-			while(offset_char[i] != '}')
+			w.id = strdup(op.c_str()) ;
+			w.slot = g_oCfg.Storage.Intern(w.id) ;
+			if ( !saved.count(op) && !g_oCfg.Storage.Has(w.slot) )
 			{
-				if((offset_char[i]>= 48 && offset_char[i] < 58) && (OperatorFlag == 0))
-				{
-					val_ch[k]= offset_char[i];
-					k++;
-				}
-				else if(offset_char[i]>= 65 && offset_char[i]<=122)
-				{
-					Tmp[j] = offset_char[i];
-					j++;
-				}
-				else if(offset_char[i] == '+')
-				{
-					OperatorFlag = 1;
-					val_ch[k] = '\0';
-				}	
-				i++;
+				LOG_ERROR("Error - step %i: match on id [%s] not saved by a previous step\n", no, w.id) ;
+				ok = false ;
 			}
-			
-			
-			Tmp[j]='}';
-			
-			Tmp[++j]='\0';
-			
-			offset_char = Tmp;
-			
-			
-			
-			if(OperatorFlag == 1)
+		}
+		getLayerType( c3, w.src.layer) ;
+		c3.Get(w.src.offset).Get(w.srcSize) ;
+
+		c3.Get(op) ;
+		if ( !::getMsgType(op.c_str(), w.msgType) || !MsgLayout[w.msgType] )
+		{
+			LOG_ERROR("Error - step %i: no layout for match message type [%s]\n", no, op.c_str()) ;
+			ok = false ;
+		}
+		c3.Get(op) ;
+		if ( !checkLayer(no, "match", op.c_str(), w.msgType, w.layer) )
+			ok = false ;
+
+		std::string offset, size, data, mask ;
+		c3.Get(offset).Get(size).Get(data).Get(mask) ;
+		if ( offset.c_str()[0] != '{' ) w.offset = atoi(offset.c_str()) ;
+		else if ( !foldInt(offset.c_str(), w.offset, w.offset_char) ) cw.offset = strdup(offset.c_str()) ;
+		if ( size.c_str()[0] != '{' ) w.size = atoi(size.c_str()) ;
+		else if ( !foldInt(size.c_str(), w.size, w.size_char) ) cw.size = strdup(size.c_str()) ;
+		if ( w.offset < 0 || w.size < 0 )
+		{
+			LOG_ERROR("Error - step %i: negative match offset/size [%s|%s]\n", no, offset.c_str(), size.c_str()) ;
+			ok = false ;
+		}
+		if ( !mask.empty() )
+		{
+			if ( w.op != OP_EQ || w.bitchk )
 			{
-				
-				Cnst = atoi(val_ch);
-				
+				LOG_ERROR("Error - step %i: match mask [%s] only goes with eq and no bitchk\n", no, mask.c_str()) ;
+				ok = false ;
 			}
-			
-			std::stringstream os_offset ;
-			expandPlaceHolders(offset_char,os_offset);
-			
-			w.offset_char = strdup( os_offset.str().c_str() );
-			int offset_tmp = atoi(w.offset_char);
-			
-			w.offset = offset_tmp;
-			
-			if(OperatorFlag == 1)
+			w.mask = strdup(mask.c_str()) ;
+		}
+
+		std::string folded ;
+		if ( w.id )
+			cw.data = strdup(data.c_str()) ;
+		else if ( foldPlaceHolders(data.c_str(), folded) )
+			cw.data = strdup(folded.c_str()) ;
+		else
+		{
+			w.data = strdup(folded.c_str()) ;
+			if ( w.reversechk && !w.bitchk && !w.mask )
+				reverseBytes(w.data) ;
+		}
+		/* a constant mask/value is checked now, one with placeholders once bound */
+		std::vector<unsigned char> bits ;
+		if ( (w.bitchk || w.mask) && w.data && !cw.size && !maskBytes(w, bits) )
+		{
+			LOG_ERROR("Error - step %i: %s [%s] does not fit match size %i\n", no
+				, w.bitchk ? "bit pattern" : "mask/value", w.data, w.size) ;
+			ok = false ;
+		}
+		cs.waits.push_back(cw) ;
+	}
+
+	c1.Eor(false) ;
+	/* Read Modify/Save */
+	std::set<std::string> saves ;
+	while ( ! c1.Eor() )
+	{
+		c1.Get(rec, recLen) ;
+		if ( !recLen )
+			break ;
+
+		c3.SetLine(rec, recLen).SetSeparator('|') ;
+
+		struct TagModify m ;
+		memset( &m, 0, sizeof(m) ) ;
+		m.slot = -1 ;
+		c3.Get(op) ;
+		if ( op.empty() )
+		{
+			LOG_ERROR("Error - step %i: Save without id\n", no) ;
+			ok = false ;
+		}
+		else
+		{
+			m.id = strdup(op.c_str()) ;
+			m.slot = g_oCfg.Storage.Intern(m.id) ;
+			saves.insert(op) ;
+		}
+		c3.Get(m.operation) ;
+		if ( m.operation && m.operation[0] )
+			sscanf( m.operation, "%c%lx", &m.op, &m.operand ) ;
+		c3.Get(m.size) ;
+		c3.Get(op) ;
+		if ( !checkLayer(no, "save", op.c_str(), cs.msgType, m.src.layer) )
+			ok = false ;
+		c3.Get(m.src.offset) ;
+		cs.saves.push_back( m );
+	}
+
+	/* Read Modify/Copy */
+	while ( ! c1.Eor() )
+	{
+		c1.Get(rec, recLen) ;
+		if ( !recLen )
+			break ;
+
+		c3.SetLine(rec, recLen).SetSeparator('|') ;
+
+		struct TagModify m ;
+		memset( &m, 0, sizeof(m) ) ;
+		m.slot = -1 ;
+		c3.Get(op) ;
+		if ( !op.empty() )
+		{
+			m.id = strdup(op.c_str()) ;
+			m.slot = g_oCfg.Storage.Intern(m.id) ;
+			if ( !saved.count(op) && !g_oCfg.Storage.Has(m.slot) )
 			{
-				w.offset += Cnst;
+				LOG_ERROR("Error - step %i: copy of id [%s] not saved by a previous step\n", no, m.id) ;
+				ok = false ;
 			}
-			
-			
-		
-		
 		}
-		
-	
-		i = 0;j=1;k=0;
-		char Tmp1[30];
-		OperatorFlag = 0;
-		Tmp1[0]='{';
-		
-		if(size_char[0] != '{')
+		c3.Get(m.size) ;
+		c3.Get(op) ;
+		if ( !checkLayer(no, "copy source", op.c_str(), MSG_UNKNOWN, m.src.layer) )
+			ok = false ;
+		c3.Get(m.src.offset) ;
+		c3.Get(op) ;
+		if ( !checkLayer(no, "copy destination", op.c_str(), cs.msgType, m.dst.layer) )
+			ok = false ;
+		c3.Get(m.dst.offset) ;
+		LOG_DEBUG("Copy:Src[id:%s],[size:%u],[layer:%i],[offset:%i] Dst[layer:%i],[offset:%i]\n"
+			, m.id, m.size, m.src.layer, m.src.offset, m.dst.layer, m.dst.offset) ;
+		cs.copies.push_back(m) ;
+	}
+	saved.insert( saves.begin(), saves.end() ) ;
+	if ( (!cs.saves.empty() || !cs.copies.empty()) && (cs.msgType == MSG_UNKNOWN || !MsgLayout[cs.msgType]) )
+	{
+		LOG_ERROR("Error - step %i: Save/Copy need a message type with a layout\n", no) ;
+		ok = false ;
+	}
+
+	/// Copy offsets address the message as written, placeholders included
+	const char* msg = c1.CurrentIt() ;
+	if ( *msg == ',' )
+		++msg ;
+	if ( cs.copies.empty() )
+		foldPlaceHolders(msg, cs.outLine) ;
+	else
+		cs.outLine = msg ;
+	return ok ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get the steps of a script from its compiled records.
+/// @param cache	Mapped cache
+/// @param steps	Steps, as compileScript() would give them
+/// @retval false when a record is damaged, or an id is not saved by a
+/// previous step nor loaded from the -s snapshot
+/// @remarks The ids are interned again in script order and the RF nodes
+/// looked up by name. The Tagwait and TagModify strings point into the
+/// mapping. The ids are checked again since the snapshot may differ from the
+/// one the script was compiled with.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::loadScript(const CScriptCache& cache, std::vector<CompiledStep>& steps)
+{
+	std::set<int> saved ;
+	int errors = 0 ;
+
+	steps.resize( cache.StepCount() ) ;
+	for ( unsigned i = 0; i < cache.StepCount(); ++i )
+	{
+		const ScriptCacheStep& r = cache.Step(i) ;
+		CompiledStep& cs = steps[i] ;
+		const char *text = cache.String(r.text), *desc = cache.String(r.desc) ;
+		const char *rfNode = cache.String(r.rfNode), *outLine = cache.String(r.outLine) ;
+		if ( !text || !desc || !rfNode || !outLine
+		||   (size_t)r.firstWait + r.waits > cache.WaitCount()
+		||   (size_t)r.firstModify + r.saves + r.copies > cache.ModifyCount() )
 		{
-			
-			w.size = atoi(size_char);
-			
+			LOG_ERROR("Error - %s: step record %u is damaged\n", cache.Path(), i + 1) ;
+			return false ;
 		}
-		else
+		cs.no = r.no ;
+		cs.text = text ;
+		cs.desc = desc ;
+		if ( !getRfNode(rfNode, cs.rfNode, cs.host, cs.ackLoggerPort, cs.backbonePort) )
+			++errors ;
+		cs.msgType = r.msgType ;
+		cs.timeout = r.timeout ;
+		cs.policy = r.policy ;
+		if ( cache.String(r.loopText) )
+			cs.loopText = cache.String(r.loopText) ;
+		cs.loop.start = r.loopStart ;
+		cs.loop.end = r.loopEnd ;
+		cs.loop.increment = r.loopIncrement ;
+		cs.loop.pace = r.loopPace ;
+		cs.loop.batch = r.loopBatch ;
+		cs.loop.rate = r.loopRate ;
+		cs.loop.burst = r.loopBurst ;
+		cs.loop.jitterUs = r.loopJitterUs ;
+		cs.outLine = outLine ;
+
+		cs.waits.resize( r.waits ) ;
+		for ( unsigned k = 0; k < r.waits; ++k )
 		{
-		
-			while(size_char[i] != '}')
+			const ScriptCacheWait& rw = cache.Wait( r.firstWait + k ) ;
+			CompiledWait& cw = cs.waits[k] ;
+			memset( &cw, 0, sizeof(cw) ) ;
+			Tagwait& w = cw.w ;
+			w.msgType = rw.msgType ;
+			w.layer = rw.layer ;
+			w.op = rw.op ;
+			w.typechk = rw.typechk ;
+			w.bitchk = rw.bitchk ;
+			w.reversechk = rw.reversechk ;
+			w.offset = rw.offset ;
+			w.size = rw.size ;
+			w.offset_char = cache.String(rw.offsetChar) ;
+			w.size_char = cache.String(rw.sizeChar) ;
+			w.data = cache.String(rw.data) ;
+			w.mask = cache.String(rw.mask) ;
+			w.id = cache.String(rw.id) ;
+			w.slot = -1 ;
+			if ( w.id )
 			{
-				if((size_char[i]>= 48 && size_char[i] < 58) && (OperatorFlag == 0))
-				{
-					val_ch[k]= size_char[i];
-					k++;
-				}
-				else if(size_char[i]>= 65 && size_char[i]<=122)
+				w.slot = g_oCfg.Storage.Intern(w.id) ;
+				if ( !saved.count(w.slot) && !g_oCfg.Storage.Has(w.slot) )
 				{
-					Tmp1[j] = size_char[i];
-					j++;
+					LOG_ERROR("Error - step %i: match on id [%s] not saved by a previous step\n", cs.no, w.id) ;
+					++errors ;
 				}
-				else if(size_char[i] == '+')
-				{
-					OperatorFlag = 1;
-					val_ch[k] = '\0';
-				}	
-				i++;
 			}
+			w.srcSize = rw.srcSize ;
+			w.src.layer = rw.src[0] ;
+			w.src.offset = rw.src[1] ;
+			w.src.msgtype = rw.src[2] ;
+			cw.offset = cache.String(rw.unboundOffset) ;
+			cw.size = cache.String(rw.unboundSize) ;
+			cw.data = cache.String(rw.unboundData) ;
+		}
 
-			
-			Tmp1[j]='}';
-				
-			Tmp1[++j]='\0';
-					
-			size_char = Tmp1;
-			
-			Cnst = 0;
-			
-			if(OperatorFlag == 1)
+		std::set<int> saves ;
+		for ( unsigned k = 0; k < r.saves + r.copies; ++k )
+		{
+			const ScriptCacheModify& rm = cache.Modify( r.firstModify + k ) ;
+			struct TagModify m ;
+			memset( &m, 0, sizeof(m) ) ;
+			m.size = rm.size ;
+			m.operation = cache.String(rm.operation) ;
+			m.op = (char)rm.op ;
+			m.operand = (long)rm.operand ;
+			m.id = cache.String(rm.id) ;
+			m.slot = m.id ? g_oCfg.Storage.Intern(m.id) : -1 ;
+			m.src.layer = rm.src[0] ;
+			m.src.offset = rm.src[1] ;
+			m.src.msgtype = rm.src[2] ;
+			m.dst.layer = rm.dst[0] ;
+			m.dst.offset = rm.dst[1] ;
+			m.dst.msgtype = rm.dst[2] ;
+			if ( k < r.saves )
 			{
-				
-				Cnst = atoi(val_ch);
-				
+				saves.insert(m.slot) ;
+				cs.saves.push_back(m) ;
+				continue ;
 			}
-			
-			std::stringstream os_size ;
-			expandPlaceHolders(size_char,os_size);
-		
-			w.size_char = strdup( os_size.str().c_str() );
-			int size_tmp = atoi(w.size_char);
-			
-			w.size = size_tmp;
-		
-			if(OperatorFlag == 1)
+			if ( m.id && !saved.count(m.slot) && !g_oCfg.Storage.Has(m.slot) )
 			{
-				w.size += Cnst;
+				LOG_ERROR("Error - step %i: copy of id [%s] not saved by a previous step\n", cs.no, m.id) ;
+				++errors ;
 			}
-			
-			
-			
-		}
-		
-		
-		
-if(w.id)//Get stored data to compare
-{
-if(!getStoredCompare(w,data))
-{
-	LOG_DEBUG("Error:Unable to get stored id:%s\n", w.id ) ;
-       return false;
-}
-
+			cs.copies.push_back(m) ;
+		}
+		saved.insert( saves.begin(), saves.end() ) ;
+	}
+	if ( errors )
+	{
+		LOG_ERROR("Error - %i errors in the steps of %s, the script is not run\n", errors, cache.Path()) ;
+		return false ;
+	}
+	LOG_INFO("Script loaded: %u steps\n", (unsigned)steps.size()) ;
+	return true ;
 }
 
-		std::stringstream os ;
-		expandPlaceHolders(data,os);
-		w.data = strdup( os.str().c_str() );
-		
-
-if(w.reversechk)
-{
-
-int i1=0,i2=strlen(w.data)-2;
-char t1,t2;
-while(i1<i2)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write the compiled steps of a script to its cache.
+/// @param cache	Cache opened for the script
+/// @param steps	Steps given by compileScript()
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::storeScript(CScriptCache& cache, const std::vector<CompiledStep>& steps)
 {
-t1=w.data[i1];
-t2=w.data[i1+1];
-w.data[i1]=w.data[i2];
-w.data[i2]=t1;
-w.data[i1+1]=w.data[i2+1];
-w.data[i2+1]=t2;
-i2-=2;
-i1+=2;
-
-}
-
-}
-		params.WaitVec.push_back(w) ;
-	}
-
-	c1.Eor(false) ;
-	/* Read Modify/Save */
-	std::string save ;
+	std::vector<ScriptCacheStep> records ;
+	std::vector<ScriptCacheModify> modifies ;
+	std::vector<ScriptCacheWait> waits ;
+	std::string strings ;
 
-	while ( ! c1.Eor() )
+	records.resize( steps.size() ) ;
+	for ( size_t i = 0; i < steps.size(); ++i )
 	{
-		c1.Get(save) ;
-		if ( save == "" )
+		const CompiledStep& cs = steps[i] ;
+		ScriptCacheStep& r = records[i] ;
+		memset( &r, 0, sizeof(r) ) ;
+		r.no = cs.no ;
+		r.text = CScriptCache::AddString( strings, cs.text.c_str() ) ;
+		r.desc = CScriptCache::AddString( strings, cs.desc.c_str() ) ;
+		r.rfNode = CScriptCache::AddString( strings, cs.rfNode ) ;
+		r.msgType = cs.msgType ;
+		r.timeout = cs.timeout ;
+		r.policy = cs.policy ;
+		r.loopText = cs.loopText.empty() ? SCRIPT_CACHE_NULL : CScriptCache::AddString( strings, cs.loopText.c_str() ) ;
+		r.loopStart = cs.loop.start ;
+		r.loopEnd = cs.loop.end ;
+		r.loopIncrement = cs.loop.increment ;
+		r.loopPace = cs.loop.pace ;
+		r.loopBatch = cs.loop.batch ;
+		r.loopRate = cs.loop.rate ;
+		r.loopBurst = cs.loop.burst ;
+		r.loopJitterUs = cs.loop.jitterUs ;
+		r.outLine = CScriptCache::AddString( strings, cs.outLine.c_str() ) ;
+
+		r.firstWait = waits.size() ;
+		r.waits = cs.waits.size() ;
+		for ( size_t k = 0; k < cs.waits.size(); ++k )
 		{
-			
-			LOG_DEBUG("No Modify/Save\n");
-			break ;
+			const CompiledWait& cw = cs.waits[k] ;
+			const Tagwait& w = cw.w ;
+			ScriptCacheWait rw ;
+			memset( &rw, 0, sizeof(rw) ) ;
+			rw.msgType = w.msgType ;
+			rw.layer = w.layer ;
+			rw.op = w.op ;
+			rw.typechk = w.typechk ;
+			rw.bitchk = w.bitchk ;
+			rw.reversechk = w.reversechk ;
+			rw.offset = w.offset ;
+			rw.size = w.size ;
+			rw.offsetChar = CScriptCache::AddString( strings, w.offset_char ) ;
+			rw.sizeChar = CScriptCache::AddString( strings, w.size_char ) ;
+			rw.data = CScriptCache::AddString( strings, w.data ) ;
+			rw.mask = CScriptCache::AddString( strings, w.mask ) ;
+			rw.id = CScriptCache::AddString( strings, w.id ) ;
+			rw.srcSize = w.srcSize ;
+			rw.src[0] = w.src.layer ;
+			rw.src[1] = w.src.offset ;
+			rw.src[2] = w.src.msgtype ;
+			rw.unboundOffset = CScriptCache::AddString( strings, cw.offset ) ;
+			rw.unboundSize = CScriptCache::AddString( strings, cw.size ) ;
+			rw.unboundData = CScriptCache::AddString( strings, cw.data ) ;
+			waits.push_back(rw) ;
 		}
 
-		c3.SetLine(save.c_str()).SetSeparator('|') ;
-
-		struct TagModify m ;
-		c3.Get(m.id) ;
-		if ( *m.id == '\0' )
+		r.firstModify = modifies.size() ;
+		r.saves = cs.saves.size() ;
+		r.copies = cs.copies.size() ;
+		for ( size_t k = 0; k < cs.saves.size() + cs.copies.size(); ++k )
 		{
-			free(m.id) ;
-			m.id = NULL ;
+			const TagModify& m = k < cs.saves.size() ? cs.saves[k] : cs.copies[k - cs.saves.size()] ;
+			ScriptCacheModify rm ;
+			memset( &rm, 0, sizeof(rm) ) ;
+			rm.size = m.size ;
+			rm.operation = CScriptCache::AddString( strings, m.operation ) ;
+			rm.op = m.op ;
+			rm.operand = m.operand ;
+			rm.id = CScriptCache::AddString( strings, m.id ) ;
+			rm.src[0] = m.src.layer ;
+			rm.src[1] = m.src.offset ;
+			rm.src[2] = m.src.msgtype ;
+			rm.dst[0] = m.dst.layer ;
+			rm.dst[1] = m.dst.offset ;
+			rm.dst[2] = m.dst.msgtype ;
+			modifies.push_back(rm) ;
 		}
-		c3.Get(m.operation) ;
-		c3.Get(m.size) ;
-		getLayerType( c3, m.src.layer) ;
-		c3.Get(m.src.offset) ;
-		//LOG_INFO("\t\t ***RKP LINE:1356 Save:[id:%s],[size:%u],[layer:%s],[offset:%i]***  \n", m.id, m.size, op.c_str() ,m.src.offset ) ;
-		params.StoreVec.push_back( m );
-		//LOG_INFO("\n Ln:1500 End of save\n");
 	}
+	cache.Store( records, modifies, waits, strings ) ;
+}
 
-	/* Read Modify/Copy */
-	std::string copy ;
-	while ( ! c1.Eor() )
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check the layer named by a Match, Save or Copy element.
+/// @param no	Step number, for the log
+/// @param what	Element, for the log
+/// @param layer	Layer name; empty selects the start of the message
+/// @param msgType	Message type the layer is looked up in; MSG_UNKNOWN when
+/// the type is only known at run time
+/// @param type	Layer type
+/// @retval false when the layer is unknown or not part of the message type
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::checkLayer(int no, const char* what, const char* layer, int msgType, int& type)
+{
+	if ( !getLayerType(layer, type) && layer[0] )
 	{
-		c1.Get(copy) ;
-		if ( copy == "" )
-			break ;
+		LOG_ERROR("Error - step %i: unknown %s layer [%s]\n", no, what, layer) ;
+		return false ;
+	}
+	if ( msgType == MSG_UNKNOWN || !MsgLayout[msgType] )
+		return true ;
+	if ( offset(MsgLayout[msgType], (FIELD_TYPE)type) == -1 )
+	{
+		LOG_ERROR("Error - step %i: %s layer [%s] is not part of %s\n", no, what, layer, getMsgType(msgType)) ;
+		return false ;
+	}
+	return true ;
+}
 
-		c3.SetLine(copy.c_str()).SetSeparator('|') ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get the parameters of a compiled step for this run.
+/// @param cs	Compiled step
+/// @param params	Parameters of the step
+/// @param outLine	Message to send, allocated
+/// @param outLineSz	Message size
+/// @retval	false when a saved id the step compares to is not available
+/// @remarks Only the fields compileStep() left unresolved are expanded here.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::bindStep(const CompiledStep& cs, struct Params& params, char *& outLine, int& outLineSz)
+{
+	params.desc = (char*)cs.desc.c_str() ;
+	strcpy(desc1, params.desc) ;
+	LOG_INFO("\n-------MESSAGE  DESCREPTION: %s--------- \n\n", params.desc);
 
-		struct TagModify m ;
-		c3.Get(m.id) ;
-		if ( *m.id == '\0' )
+	params.rfNode = cs.rfNode ;
+	strcpy(params.host, cs.host) ;
+	params.ackLoggerPort = cs.ackLoggerPort ;
+	params.backbonePort = cs.backbonePort ;
+	params.timeout = cs.timeout ;
+	LOG_INFO("\tOPTIONS : [host:%s] [timeout:%d] \n", params.host, params.timeout) ;
+	params.msgType = cs.msgType ;
+	params.policy = cs.policy ;
+	if ( cs.loopText.empty() )
+		params.loop = cs.loop ;
+	else
+		getLoop(cs.loopText.c_str(), params.loop) ;
+
+	for ( size_t i = 0; i < cs.waits.size(); ++i )
+	{
+		const CompiledWait& cw = cs.waits[i] ;
+		struct Tagwait w = cw.w ;
+		if ( cw.offset )
+			w.offset = resolveInt(cw.offset, w.offset_char) ;
+		if ( cw.size )
+			w.size = resolveInt(cw.size, w.size_char) ;
+		if ( cw.data )
 		{
-			free(m.id) ;
-			m.id = NULL ;
+			/// getStoredCompare() writes the saved value over the data
+			std::vector<char> data( strlen(cw.data) + (w.size > 0 ? w.size : 0) + 32 ) ;
+			strcpy( &data[0], cw.data ) ;
+			if ( w.id && !getStoredCompare(w, &data[0]) )
+			{
+				LOG_DEBUG("Error:Unable to get stored id:%s\n", w.id ) ;
+				return false ;
+			}
+			std::stringstream os ;
+			expandPlaceHolders(&data[0], os) ;
+			w.data = strdup( os.str().c_str() ) ;
+			if ( w.reversechk && !w.bitchk && !w.mask )
+				reverseBytes(w.data) ;
 		}
-		c3.Get(m.size) ;
-		getLayerType( c3, m.src.layer) ;
-		c3.Get(m.src.offset) ;
-		LOG_DEBUG("Copy:Src[id:%s],[size:%u],[layer:%i],[offset:%i]  ", m.id, m.size, m.src.layer ,m.src.offset ) ;
-
-		/* read dst layer type */
-		getLayerType( c3, m.dst.layer) ;
-		c3.Get(m.dst.offset) ;
-		LOG_DEBUG("Copy:Dst[layer:%i],[offset:%i]\n", m.dst.layer,m.dst.offset ) ;
-		params.LoadVec.push_back(m) ;
+		params.WaitVec.push_back(w) ;
 	}
-	
-	if ( *c1.CurrentIt() == ',' )
+	compileMatch(params) ;
+	params.StoreVec = cs.saves ;
+	params.LoadVec = cs.copies ;
+
+	outLineSz = cs.outLine.size() ;
+	outLine = (char*)malloc( outLineSz+1 ) ;
+	memcpy( outLine, cs.outLine.c_str(), outLineSz+1 ) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reverse the byte order of a hex string, in place.
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::reverseBytes(char* data)
+{
+	int i1=0,i2=strlen(data)-2;
+	char t1,t2;
+	while(i1<i2)
 	{
-		size_t s =strlen( (char*) (c1.CurrentIt()+1) );
-		outLineSz =s;
-		outLine = (char*)malloc( outLineSz+1 );
-		memcpy(outLine, (char*) (c1.CurrentIt()+1), s );
-		outLine[s]=0;
+		t1=data[i1];
+		t2=data[i1+1];
+		data[i1]=data[i2];
+		data[i2]=t1;
+		data[i1+1]=data[i2+1];
+		data[i2+1]=t2;
+		i2-=2;
+		i1+=2;
 	}
-	else
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode the mask and the value of a bitchk or mask Match element.
+/// @param w	Element, with its size and data resolved
+/// @param out	Mask bytes then value bytes, (size+1)/2 of each, appended
+/// @retval false when the mask or the value does not fit the size
+/// @remarks A bitchk element gives its bits in binary, x for a bit that is not
+/// checked; a mask element gives its mask and value in hex. Both are numbers
+/// aligned on their least significant bit, that is the end of the field, or
+/// its start with reversechk.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::maskBytes(const Tagwait& w, std::vector<unsigned char>& out)
+{
+	size_t n = ( w.size + 1 ) / 2 ;
+	if ( !n )
+		return false ;
+	size_t at = out.size() ;
+	out.resize( at + 2 * n ) ;
+	unsigned char* mask = &out[at] ;
+	unsigned char* value = mask + n ;
+	bool ok = w.bitchk ? ::bitsToBytes(w.data, mask, value, n)
+		: ::hexToBytes(w.mask, mask, n) && ::hexToBytes(w.data, value, n) ;
+	if ( ok && (w.size & 1) && (mask[0] & 0xF0) )	/* the field has only half of its first byte */
+		ok = false ;
+	if ( !ok )
 	{
-		size_t s =strlen ( (char*) (c1.CurrentIt()) );
-		outLineSz = s ;
-		outLine = (char*)malloc( outLineSz );
-		memcpy(outLine, (char*) (c1.CurrentIt()), s );
-		outLine[s]=0;
+		out.resize(at) ;
+		return false ;
 	}
-
-	LOG_DEBUG("\n");
-	if ( NULL!=params.currentId && *params.currentId == '\0' )
+	if ( w.reversechk )
 	{
-		free(params.currentId) ;
-		params.currentId = NULL ;
+		std::reverse( mask, mask + n ) ;
+		std::reverse( value, value + n ) ;
 	}
-	
-	
+	for ( size_t i = 0; i < n; ++i )
+		value[i] &= mask[i] ;
 	return true ;
 }
 
 bool ScriptServer::getLoop( const char*loopStr,struct loop_spec& loop)
 {
 	loop.increment = 0;
+	loop.pace = -1;
+	loop.batch = 0;
+	loop.rate = 0;
+	loop.burst = 0;
+	loop.jitterUs = 0;
 	std::stringstream out;
 	expandPlaceHolders(loopStr,out) ;
-	int rv = sscanf(out.str().c_str(),"%x;%x;%x", &loop.start, &loop.end, &loop.increment);
+	int rv = sscanf(out.str().c_str(),"%x;%x;%x;%d;%d", &loop.start, &loop.end, &loop.increment, &loop.pace, &loop.batch);
 	if ( !loop.increment )
 	{
 		loop.increment = 1;
@@ -1677,36 +2482,65 @@ bool ScriptServer::getLoop( const char*loopStr,struct loop_spec& loop)
 			loop.end=1;
 		}
 	}
+	if ( rv < 4 || loop.pace < 0 )
+		loop.pace = -1 ;		/// legacy: one message every 2 seconds
+	else if ( rv < 5 )
+		loop.batch = loop.pace ? 1 : 0 ;
+
+	/// named pacing fields may follow the positional ones
+	std::string spec(out.str()) ;
+	for ( size_t pos = spec.find(';'); pos != std::string::npos; pos = spec.find(';', pos + 1) )
+	{
+		const char *field = spec.c_str() + pos + 1 ;
+		if ( !strncmp(field, "rate=", 5) )
+			loop.rate = atof(field + 5) ;
+		else if ( !strncmp(field, "burst=", 6) )
+			loop.burst = strtoul(field + 6, NULL, 10) ;
+		else if ( !strncmp(field, "jitter=", 7) )
+			loop.jitterUs = strtoul(field + 7, NULL, 10) ;
+	}
+	return true ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Apply the modifications specified in XML Modify/Copy elements
 /// @param m	Modifications list
-/// @param src	Message string
+/// @param rx	Fields of the received message
 /// @param dst	Modified string
-/// @param inType	Received message type
 /// @param myType	Message type saved from XML message
 /// @param dstSize	Modified string size
 /// @retval true when modification were applied successfully
 /// @remarks When data is copied from source string to destination string, if ',' delimiter is reached (in source) before copying the specified length,
-/// copy will stop at that delimiter.
-/// When the destination string size is too short, the string is resized so the data from source can fit in.
+/// copy will stop at that delimiter, or at the end of the source.
+/// When the destination field is too short, it grows so the data from source can fit in.
+/// A copy never adds or removes a comma, so the fields of dst are split once:
+/// each field a copy writes to is spliced in a copy of its own, the others
+/// stay where they are in dst, and the message is written out once, after
+/// the last copy.
 ////////////////////////////////////////////////////////////////////////////////
-bool ScriptServer::loadAll(std::vector<struct TagModify>& m, char* src, char*& dst, int inType, int myType, int& dstSize)
+bool ScriptServer::loadAll(std::vector<struct TagModify>& m, const CMsgView& rx, char*& dst, int myType, int& dstSize)
 {
+	if ( m.empty() )
+		return true ;
+	int inType = rx.Type() ;
+	CMsgView saved, out ;
+	out.Parse(dst) ;
+	std::map<int, std::string> edited ;	///< fields written by the copies, by number
 	for ( size_t i = 0; i < m.size(); ++i)
 	{
+		const CMsgView* src = &rx ;
 		if ( m[i].id )
 		{
-			if ( g_oCfg.StorageMap.find( m[i].id ) == g_oCfg.StorageMap.end() )
+			if ( !g_oCfg.Storage.Has( m[i].slot ) )
 			{
 				LOG_INFO("ERROR: undefined reference to ID:%s. It was not saved previously\n", m[i].id ) ;
 				//Modified By Honeywell - RK Praveen
 				//return false to true - change is made to continue for failcontinue to pass though buffer is empty
-				return true ;
+				break ;
 			}
-			src = g_oCfg.StorageMap[m[i].id] ; // check to see if the id is in the map
-			LOG_INFO("\tLoad saved content:[id:%s]<%s>\n", m[i].id, src) ;
+			saved.Parse( g_oCfg.Storage.Get( m[i].slot ), false ) ;
+			src = &saved ;
+			LOG_INFO("\tLoad saved content:[id:%s]<%s>\n", m[i].id, saved.Data()) ;
 		}
 
 		/*Position */
@@ -1720,154 +2554,171 @@ bool ScriptServer::loadAll(std::vector<struct TagModify>& m, char* src, char*& d
 			return false;
 		}
 
-		char *psrc = searchComma( src, srcCommas);
-		if ( NULL==psrc ) return false;
-		char *pdst = searchComma( dst, dstCommas);
-		if ( NULL==pdst ) return false;
+		char *psrc = src->Field(srcCommas);
+		if ( NULL==psrc )
+		{
+			LOG_INFO( "Error - Mod(%i):Malformed src CSV line[%s]\n", srcCommas, src->Data()) ;
+			return false;
+		}
+		char *pdst = out.Field(dstCommas);
+		if ( NULL==pdst )
+		{
+			LOG_INFO( "Error - Mod(%i):Malformed dst CSV line[%s]\n", dstCommas, dst) ;
+			return false;
+		}
 
 		int copyLength = m[i].size; ///number of characters to copy
 
 		///copy m[i].size characters from source, but stop if ',' is reached before copy length
-		char *pSrcLimit = searchComma(psrc + m[i].src.offset, 1); ///search first ',' from copy start position
-		if (pSrcLimit) {
-			copyLength = pSrcLimit - (psrc + m[i].src.offset) - 1;
-		}
-		if (copyLength > m[i].size) {
-			copyLength = m[i].size;
-		}
-		else if (copyLength < m[i].size) {
-			LOG_INFO("\tPreparing copy - encountered ',' delimiter -> limit copy size to %i (instead of %i)\n", copyLength, m[i].size);
+		const char *from = psrc + m[i].src.offset ;
+		const char *pSrcLimit = src->Comma(from); ///first ',' from copy start position
+		const char *pSrcEnd = pSrcLimit ? pSrcLimit : std::max<const char*>( from, src->Data() + src->Length() ) ;
+		if ( pSrcEnd - from < copyLength ) {
+			copyLength = pSrcEnd - from;
+			if (pSrcLimit) {
+				LOG_INFO("\tPreparing copy - encountered ',' delimiter -> limit copy size to %i (instead of %i)\n", copyLength, m[i].size);
+			}
 		}
 
-		///resize dst when there's more to copy than it fits
-		int dstCopySpace = dstSize - (pdst - dst) - m[i].dst.offset;
-		char *pDstLimit = searchComma(pdst + m[i].dst.offset, 1); ///search first ',' from copy start position
-		if (pDstLimit) {
-			dstCopySpace = pDstLimit - (pdst + m[i].dst.offset) - 1;
-		}
+		std::map<int, std::string>::iterator field = edited.find(dstCommas) ;
+		if ( field == edited.end() )
+			field = edited.insert( std::make_pair(dstCommas, std::string(pdst, out.FieldLength(dstCommas))) ).first ;
+		std::string& to = field->second ;
 
+		///grow the field when there's more to copy than it fits
+		int dstCopySpace = (int)to.size() - m[i].dst.offset;
 		if (dstCopySpace < 0) {
 			LOG_ERROR("ERROR: invalid offset specified for COPY>Dst field: %i\n", m[i].dst.offset);
 			return false;
 		}
-
 		if (dstCopySpace < copyLength) {
 			LOG_INFO("\tDestination copy space is not enough -> resize (size=%i, needed=%i) \n", dstCopySpace, copyLength);
-			int extraSpaceNeeded = copyLength - dstCopySpace;
-			dstSize += extraSpaceNeeded + 1; ///+1 for string terminator
-			char *tempDst = (char*) realloc(dst, dstSize);
-			if (tempDst) {
-				dst = tempDst;
-			}
-			else {
-				LOG_ERROR("ERROR: Unable to reallocate memory for COPY; size=%u\n", dstSize);
-				return false;
-			}
-
-			*(dst + dstSize - 1) = 0;
-
-			pdst = searchComma(dst, dstCommas); ///reposition pointer to copy location
-			if ( NULL==pdst ) return false ;
-
-			///reposition data that followed copy location - needed only if there was data after destination copy space
-			char *pDstLimit = searchComma(pdst + m[i].dst.offset, 1); ///search first ',' from copy start position
-			if (pDstLimit) {
-				int moveLength = dstSize - extraSpaceNeeded - (pDstLimit - dst) + 1; /// +1 = includes delimiter
-				LOG_DEBUG("\t reposition data - move %i chars\n", moveLength);
-				memmove(pDstLimit - 1 + extraSpaceNeeded, pDstLimit - 1, moveLength); /// -1 = includes delimiter
-			}
 		}
+		to.replace( m[i].dst.offset, std::min(dstCopySpace, copyLength), from, copyLength ) ;
 
-		memcpy(pdst + m[i].dst.offset, psrc + m[i].src.offset, copyLength) ;
+		LOG_INFO("\tCOPY(sz:%i srcOffset:%i dstOffset:%i srcComma:%i dstComma:%i):<%.*s>\n",
+				copyLength, m[i].src.offset, m[i].dst.offset, srcCommas, dstCommas, copyLength, to.data() + m[i].dst.offset) ;
+	}
+	if ( edited.empty() )
+		return true ;
 
-		LOG_INFO("\tCOPY(sz:%i srcOffset:%i dstOffset:%i srcComma:%i dstComma:%i):<",
-				copyLength, m[i].src.offset, m[i].dst.offset, srcCommas, dstCommas) ;
-		for ( int o = 0; o < copyLength; ++o)
+	/* one write: each field from dst, or its spliced copy */
+	size_t size = out.Length() ;
+	for ( std::map<int, std::string>::const_iterator it = edited.begin(); it != edited.end(); ++it )
+		size += it->second.size() - out.FieldLength(it->first) ;
+	char *line = (char*) malloc(size + 1) ;
+	if ( !line )
+	{
+		LOG_ERROR("ERROR: Unable to allocate memory for COPY; size=%u\n", (unsigned)size);
+		return false ;
+	}
+	char *at = line ;
+	std::map<int, std::string>::const_iterator next = edited.begin() ;
+	for ( unsigned k = 0; k < out.Fields(); ++k )
+	{
+		if ( k )
+			*at++ = ',' ;
+		if ( next != edited.end() && next->first == (int)k )
 		{
-			LOG_INFO("%c", *(pdst+m[i].dst.offset+o) ) ;
+			memcpy( at, next->second.data(), next->second.size() ) ;
+			at += next->second.size() ;
+			++next ;
+		}
+		else
+		{
+			memcpy( at, out.Field(k), out.FieldLength(k) ) ;
+			at += out.FieldLength(k) ;
 		}
-		LOG_INFO(">\n") ;
 	}
+	*at = 0 ;
+	free(dst) ;
+	dst = line ;
+	dstSize = size ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read the number a Save operation works on from the decoded bytes
+/// of the received layer.
+/// @retval false when the saved span is not whole bytes of hex digits that
+/// fit a long; the caller then parses the text
+////////////////////////////////////////////////////////////////////////////////
+static bool savedNumber(const CMsgView& rx, int field, const TagModify& m, long& value)
+{
+	if ( m.size <= 0 || m.size > (int)(2 * sizeof(long)) || (m.size & 1) || (m.src.offset & 1) || m.src.offset < 0 )
+		return false ;
+	size_t digits ;
+	const unsigned char* b = rx.Bytes(field, digits) ;
+	if ( !b || digits < (size_t)(m.src.offset + m.size) )
+		return false ;
+	unsigned long v = 0 ;
+	for ( int k = 0; k < m.size / 2; ++k )
+		v = v << 8 | b[m.src.offset / 2 + k] ;
+	value = (long)v ;
 	return true ;
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Apply the modifications specified in XML Modify/Save elements
 /// @param m	Modifications list
-/// @param src	Message string
+/// @param rx	Fields of the received message
 /// @param myType	Message type saved from XML message
 /// @retval true when the modifications were applied successfully
 ////////////////////////////////////////////////////////////////////////////////
-bool ScriptServer::saveAll(std::vector<struct TagModify>& m, char* src, int type)
+bool ScriptServer::saveAll(std::vector<struct TagModify>& m, const CMsgView& rx, int type)
 {
 	//LOG_INFO("RKP: saveAll Start");
 	for ( size_t i = 0; i < m.size(); ++i)
 	{
 		//LOG_INFO("\nRKP: In For Ln: 1700");
-		int srcCommas, dstCommas ;
+		int srcCommas ;
 		//if ( ! m[i].id ) continue ;
 
 		srcCommas=offset(MsgLayout[type], FIELD_TYPE(m[i].src.layer) );
-		char*psrc = searchComma( src, srcCommas ) ;
+		char*psrc = rx.Field( srcCommas ) ;
 		//if ( NULL==psrc ) return false ;
 		//Modified by honeywell - RK Praveen
 		if ( NULL==psrc ) return true ;
 		//LOG_INFO("\nRKP: Ln: 1707\n");
-		char * content ;
-		if ( m[i].size != 0 )
+		/* only the first save of an id counts; a value of the snapshot is saved over */
+		if ( g_oCfg.Storage.Saved( m[i].slot ) )
+			continue ;
+		const char* from = psrc + m[i].src.offset ;
+		if ( m[i].op )
 		{
-			content = (char*) calloc(m[i].size +1, sizeof(char) );
-			memcpy(content, psrc + m[i].src.offset, m[i].size) ;
+			long value, result ;
+			if ( !savedNumber(rx, srcCommas, m[i], value) )
+			{
+				std::string text = m[i].size ? std::string(from, strnlen(from, m[i].size)) : std::string(rx.Data()) ;
+				value = strtoul( text.c_str(), NULL, 16 ) ;
+			}
+			switch ( m[i].op )
+			{
+			case '+': result = value + m[i].operand ; break ;
+			case '-': result = value - m[i].operand ; break ;
+			case '*': result = value * m[i].operand ; break ;
+			case '/':
+				result = value / m[i].operand ;
+				if ( value % m[i].operand != 0 ) ++result ;
+				break ;
+			default:
+				LOG_INFO("Error:Not a valid operator%c ", m[i].op) ;
+				result = value ;
+				break ;
+			}
+			/* the text is written when it is first needed */
+			g_oCfg.Storage.SetNumber( m[i].slot, result ) ;
 		}
-		else
+		else if ( m[i].size != 0 )
 		{
-			content = strdup(src);
+			g_oCfg.Storage.Set( m[i].slot, from, strnlen(from, m[i].size) ) ;
 		}
-		if ( g_oCfg.StorageMap.find( m[i].id ) == g_oCfg.StorageMap.end() )
+		else
 		{
-if(strlen(m[i].operation)!=0)
-{
-	//LOG_INFO("RKP: Ln: 1722");
-long int opData,newvalue,iddata;
-long int tcontent; //temp
-char operator1;
-	//char* src,*OrigData=data;
-       sscanf( m[i].operation, "%c%lx",&operator1,&opData );
-       sscanf( content, "%lx",&tcontent );
-switch(operator1)
-{
-		//LOG_INFO("RKP: Ln: 1731 in switch");
-case '+':
-newvalue=opData+tcontent;
-break;
-case '-':
-newvalue=tcontent-opData;
-break;
-case '*':
-newvalue=tcontent*opData;
-break;
-case '/':
-newvalue=tcontent/opData;
-if(tcontent%opData!=0) newvalue=newvalue+1;
-break;
-default:
-LOG_INFO("Error:Not a valid operator%c ", operator1) ;
-break;
-}
-//itoa(newvalue,data);
-//sscanf(newvalue, "%s",data);
-//LOG_INFO("\nRKP: Ln: 1751\n");
-sprintf(content, "%lx", newvalue);
-int kk=0;
-	while(content[kk]!='\0')
-	{
-		if(content[kk]>=97) content[kk]-=32;
-		kk++;
-	}
-}
-			g_oCfg.StorageMap[ m[i].id ] = content;
-			LOG_INFO("\tSave content:[id:%s]<%s>\n", m[i].id, g_oCfg.StorageMap[ m[i].id ]) ;
+			g_oCfg.Storage.Set( m[i].slot, rx.Data(), strlen(rx.Data()) ) ;
 		}
+		LOG_INFO("\tSave content:[id:%s]<%s>\n", m[i].id, g_oCfg.Storage.Get( m[i].slot )) ;
 	}
 	//LOG_INFO("\nRKP: Ln: 17065 End of Saveall");
 	return true ;
@@ -1884,7 +2735,11 @@ bool ScriptServer::getOpType(CCsv& c, int& type)
 {
 	std::string op;
 	c.Get(op) ;
-	const char*msg=op.c_str();
+	return getOpType(op.c_str(), type) ;
+}
+
+bool ScriptServer::getOpType(const char* msg, int& type)
+{
 	for ( unsigned i = 0; g_OperatorTypes[i].tokenName; ++i)
 		if ( !strncmp(msg, g_OperatorTypes[i].tokenName, g_OperatorTypes[i].tokenLength) )
 		{
@@ -1924,7 +2779,11 @@ bool ScriptServer::getLayerType( CCsv& c, int& type)
 {
 	std::string op;
 	c.Get(op);
-	const char*layer=op.c_str();
+	return getLayerType(op.c_str(), type) ;
+}
+
+bool ScriptServer::getLayerType( const char* layer, int& type)
+{
 	if ( !layer ) return FIELD_UNKNOWN ;
 
 	for ( unsigned i = 0; g_LayerTypes[i].tokenName; ++i)
@@ -1952,6 +2811,7 @@ bool ScriptServer::getPolicyType(const char *policy, int& type)
 	bool found=false;
 	while ( policy && *policy )
 	{
+	const char* pass = policy ;
 	/* The logic has been changed by Honeywell ///Kiran J */
 	for (unsigned i=0;i<=7; ++i)
 		{
@@ -1964,6 +2824,7 @@ if(i==5) continue;
 				if ( '|'==*policy ) ++policy ;
 			}
 		}
+	if ( policy == pass ) { found = false ; break ; }	/// unknown token
 	}
 	if ( found ) return true ;
 
@@ -1975,20 +2836,24 @@ if(i==5) continue;
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Get RFNode parameters out of RFNode string specified in the XML message
 /// @param rfNode	RFNode string
+/// @param name		RFNode name as stored in the RF node map
 /// @param host		host parameter read from string
 /// @param ackLoggerPort	ackLoggerPort parameter read from string
 /// @param backbonePort		backbonePort parameter read from string
 /// @retval false when the RFNode was not specified in the config file
 ////////////////////////////////////////////////////////////////////////////////
-bool ScriptServer::getRfNode(const char *rfNode, char *host, int& ackLoggerPort, int& backbonePort)
-{	if (	rfNode[0] == '\0' ||
-		RfNodeMap.find(rfNode) == RfNodeMap.end() )
+bool ScriptServer::getRfNode(const char *rfNode, const char*& name, char *host, int& ackLoggerPort, int& backbonePort)
+{
+	std::map<const char*,RfNode,cmp_str>::iterator it ;
+	if (	rfNode[0] == '\0' ||
+		(it = RfNodeMap.find(rfNode)) == RfNodeMap.end() )
 	{
 		LOG_ERROR("Error - RF_node[%s] not specified\n", rfNode) ;
 		return false ;
 	}
 
-	RfNode rfnode = RfNodeMap[rfNode];
+	RfNode rfnode = it->second;
+	name = it->first ;
 
 	strcpy(host,rfnode.host);
 	ackLoggerPort=rfnode.ackLoggerPort ;
@@ -2000,6 +2865,8 @@ bool ScriptServer::getRfNode(const char *rfNode, char *host, int& ackLoggerPort,
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Parse the configuration file (ss.ini) - read the RFNodes parameters
 /// and the specified variable values that will be substituted when XML messages are processed
+/// @remarks The transmit socket of every RF node and the receive socket of every
+/// ackLogger port are opened here and kept for the whole run.
 ////////////////////////////////////////////////////////////////////////////////
 bool ScriptServer::parseConfig( )
 {
@@ -2022,6 +2889,15 @@ bool ScriptServer::parseConfig( )
 		//placeholderCallbacks.insert(std::pair<const char*, func_ptr>( it->pItem, &ScriptServer::GetConfig) ) ;
 	}
 
+	/// [EXPORT] values are looked up in memory from now on
+	if ( !m_oConfig.Loaded() )
+		m_oConfig.Load("../../Config/ss.ini") ;
+	if ( g_oCfg.WatchConfig )
+		m_oConfig.Watch() ;
+
+	if ( !m_oScheduler.Open() )
+		return false ;
+
 	ini.GetAllKeys("RF_NODES", nodes) ;
 	it = nodes.begin() ;
 	for ( ; it != nodes.end(); ++it)
@@ -2029,14 +2905,24 @@ bool ScriptServer::parseConfig( )
 		RfNode rfnode;
 		LOG_INFO("%s=%s\n", it->pItem, ini.GetValue("RF_NODES",it->pItem) );
 		char tmp[256];
-		int rv = sscanf( ini.GetValue("RF_NODES",it->pItem), "%s %i %i", tmp, &rfnode.ackLoggerPort, &rfnode.backbonePort) ;
+		rfnode.rate = 0 ;
+		rfnode.burst = 1 ;
+		rfnode.jitterUs = 0 ;
+		/// optional: rate (msgs/s) burst jitter (us)
+		int rv = sscanf( ini.GetValue("RF_NODES",it->pItem), "%s %i %i %lf %u %u", tmp, &rfnode.ackLoggerPort, &rfnode.backbonePort
+				, &rfnode.rate, &rfnode.burst, &rfnode.jitterUs) ;
 		rfnode.host = strdup(tmp);
-		if ( rv != 3 )
+		if ( rv < 3 )
 		{
 			LOG_INFO("Error - Unable to read ip ackLoggerPort backbonePort\n") ;
 			return false ;
 		}
 		RfNodeMap.insert(std::pair<const char*, RfNode>( strdup(it->pItem), rfnode)) ;
+		if ( !m_oTransport.OpenTx(it->pItem, rfnode.host, rfnode.backbonePort)
+		||   !m_oTransport.OpenRx(rfnode.ackLoggerPort) )
+		{
+			return false ;
+		}
 	}
 	return true ;
 }
@@ -2047,78 +2933,224 @@ bool ScriptServer::parseConfig( )
 /// @param line	Message string
 /// @param out	Stream containing the message having the variables replaced by values
 /// @retval true when the replacement was successfully done
+/// @remarks For a string expanded once. Strings expanded many times are
+/// compiled with compileTemplate() and expanded with expandTemplate().
 ////////////////////////////////////////////////////////////////////////////////
 bool ScriptServer::expandPlaceHolders(const char* line, std::stringstream& out)
 {
-	
 	if ( !line )
 		return false ;
+	if ( !strchr(line, '{') )
+	{
+		out << line ;
+		return false ;
+	}
+	Template t ;
+	compileTemplate(line, t) ;
+	expandTemplate(t, out) ;
+	return t.complete ;
+}
 
-	size_t len = strlen(line) ;
-	const char *it = line, *cmdStart ;   // {Hello }
-	const char *end = line + len, *paramsStart ;
-	
-	while ( *line && it != end )
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse the placeholders of a string once.
+/// @param line	String with {COMMAND params} placeholders
+/// @param t	Literal spans and callbacks, with their parsed arguments
+/// @retval false when a placeholder is malformed or has no callback; as
+/// before, the text stops there
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::compileTemplate(const char* line, Template& t)
+{
+	t.text.clear() ;
+	t.slots.clear() ;
+	t.complete = false ;
+	if ( !line )
+		return false ;
+
+	const char *it = line ;
+	const char *end = line + strlen(line) ;
+
+	while ( it != end )
 	{
-		char cmd[512] = { 0, };
-		char params[512] = { 0, };
-		
-		while ( *it != '{' && it != end )  out.put(*it++) ;
-		if ( it == end ) {  return false ; }
-		++it ; // skip over {
+		const char* literal = it ;
+		while ( it != end && *it != '{' ) ++it ;
+		t.text.append( literal, it - literal ) ;
+		if ( it == end ) break ;
+
+		TemplateSlot slot ;
+		slot.at = t.text.size() ;
+		if ( !parsePlaceholder(it, end, slot) )
+			return false ;
+		t.slots.push_back(slot) ;
+	}
+	t.complete = true ;
+	return true ;
+}
 
-		cmdStart = it ;
-		
-		while ( it!=end && isprint(*it) && !isspace(*it) && *it!='}'
-			&& *it!=',' )
-		{
-			++it ;
-		}
-		if ( it==end || it==cmdStart ) return false ;
-			
-		memcpy(cmd, cmdStart, it - cmdStart ) ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a {COMMAND params} placeholder.
+/// @param it	At the '{'; moved past the '}'
+/// @param end	End of the string
+/// @param slot	Callback and arguments of the placeholder
+/// @retval false when the placeholder is malformed or has no callback
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::parsePlaceholder(const char*& it, const char* end, TemplateSlot& slot)
+{
+	const char *cmdStart, *paramsStart ;   // {Hello }
+	++it ; // skip over {
+
+	cmdStart = it ;
+	while ( it!=end && isprint(*it) && !isspace(*it) && *it!='}'
+		&& *it!=',' )
+	{
+		++it ;
+	}
+	if ( it==end || it==cmdStart ) return false ;
+	std::string cmd( cmdStart, it - cmdStart ) ;
+
+	while ( it!=end && (isspace(*it) || *it==',' ) ) ++it ;
+
+	paramsStart = it ;
+	while ( it!=end && isprint(*it) && *it!='}' )  ++it ;
+	if ( it == end ) return false ;
+	std::string params( paramsStart, it - paramsStart ) ;
+
+	std::map<const char*, func_ptr, cmp_str>::iterator cbackIt ;
+	cbackIt = placeholderCallbacks.find(cmd.c_str()) ;
+	if ( cbackIt != placeholderCallbacks.end() )
+		slot.fn = cbackIt->second ;
+	else if ( m_oConfig.Get(cmd.c_str()) )
+		slot.fn = &ScriptServer::GetConfig ;	/// exported by a reloaded ss.ini
+	else
+	{
+		LOG_INFO("No expansion found for [%s]\n", cmd.c_str()) ;
+		return false ;
+	}
+	// Special case for Config Variables
+	if ( slot.fn == &ScriptServer::GetConfig )
+	{
+		TemplateArg arg ;
+		arg.isInt = false ;
+		arg.Int = 0 ;
+		arg.Str = cmd ;
+		slot.args.push_back(arg) ;
+	}
+	else
+		prepareStack(params.c_str(), slot.args) ;
+	++it ; // skip over }
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Expand a compiled string.
+/// @param t	Compiled string
+/// @param out	Stream the expanded string is appended to
+/// @remarks The literal spans are appended as they are; for each
+/// placeholder the arguments are pushed on the data stack and the callback
+/// writes its value.
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::expandTemplate(const Template& t, std::stringstream& out)
+{
+	size_t pos = 0 ;
+	for ( size_t i = 0; i < t.slots.size(); ++i )
+	{
+		const TemplateSlot& slot = t.slots[i] ;
+		out.write( t.text.data() + pos, slot.at - pos ) ;
+		pos = slot.at ;
+		callSlot(slot, out) ;
+	}
+	out.write( t.text.data() + pos, t.text.size() - pos ) ;
+}
 
-		
 
-		while ( it!=end && (isspace(*it) || *it==',' ) ) ++it ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Push the arguments of a placeholder and call its callback.
+/// @param slot	Placeholder
+/// @param out	Stream the value is appended to
+/// @remarks The string cells point into slot.args; whatever the callback
+/// left on the data stack is popped, so that no cell outlives the Template.
+////////////////////////////////////////////////////////////////////////////////
+void ScriptServer::callSlot(const TemplateSlot& slot, std::stringstream& out)
+{
+	size_t depth = m_oDataStack.size() ;
+	for ( size_t k = 0; k < slot.args.size(); ++k )
+	{
+		Cell cell ;
+		if ( slot.args[k].isInt )
+			cell.Int = slot.args[k].Int ;
+		else
+			cell.Str = (char*)slot.args[k].Str.c_str() ;
+		m_oDataStack.push( cell ) ;
+	}
+	(this->*slot.fn)(out) ;
+	while ( m_oDataStack.size() > depth )
+		m_oDataStack.pop() ;
+}
 
-		paramsStart = it ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Tell whether a placeholder callback gives the same value for the
+/// whole run.
+/// @remarks TAIOFFSET follows the clock, DIDX and DIDX_EXTDLUINT the loop
+/// index and LOAD the values saved by the steps: they are dynamic. The
+/// ss.ini exports are pure, unless -i reloads them when the file changes.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::isPure(func_ptr fn) const
+{
+	return fn == &ScriptServer::GetConfig && !g_oCfg.WatchConfig ;
+}
 
-		while ( it!=end && isprint(*it) && *it!='}' )  ++it ;
-		if ( it == end ) return false ;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Substitute the pure placeholders of a string at load time.
+/// @param line	String with placeholders
+/// @param out	Same string, with only its dynamic placeholders left
+/// @retval true when out still holds placeholders
+/// @remarks A malformed or unknown placeholder is kept, with all that
+/// follows it, so that the expansion at run time stops at the same place.
+/// A value holding a '{' is not substituted either.
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptServer::foldPlaceHolders(const char* line, std::string& out)
+{
+	out.clear() ;
+	bool dynamic = false ;
+	const char *it = line ;
+	const char *end = line + strlen(line) ;
 
-		memcpy(params, paramsStart, it - paramsStart ) ;
-				
-		std::map<const char*, func_ptr, cmp_str>::iterator cbackIt ;
-		cbackIt = placeholderCallbacks.find(cmd) ;
-		if ( cbackIt == placeholderCallbacks.end() )
+	while ( it != end )
+	{
+		const char* literal = it ;
+		while ( it != end && *it != '{' ) ++it ;
+		out.append( literal, it - literal ) ;
+		if ( it == end ) break ;
+
+		const char* open = it ;
+		TemplateSlot slot ;
+		if ( !parsePlaceholder(it, end, slot) )
 		{
-			LOG_INFO("No expansion found for [%s]\n", cmd) ;
-			return false ;
+			out.append( open, end - open ) ;
+			return true ;
 		}
-		// prepare the stack before calling the method
-		// Special case for Config Variables
-		if ( cbackIt->second == &ScriptServer::GetConfig )
+		if ( isPure(slot.fn) )
 		{
-			Cell cell; cell.Str = strdup(cmd);
-		
-			m_oDataStack.push( cell ) ;
-		}else
-			prepareStack(params);
-
-		(this->*placeholderCallbacks[cmd])(out) ;
-		++it ;
+			std::stringstream value ;
+			callSlot(slot, value) ;
+			if ( value.str().find('{') == std::string::npos )
+			{
+				out += value.str() ;
+				continue ;
+			}
+		}
+		out.append( open, it - open ) ;
+		dynamic = true ;
 	}
-	
-	return true ;
+	return dynamic ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Determine the type of a parameter specified for a function placeholder and store it in a parameters list
 /// @param str	Parameter string
+/// @param args	Parameters list
 /// @remarks Called by prepareStack
 ////////////////////////////////////////////////////////////////////////////////
-void ScriptServer::handle(const char* str)
+void ScriptServer::handle(const char* str, std::vector<TemplateArg>& args)
 {
 	bool isHex=false;
 
@@ -2135,21 +3167,25 @@ void ScriptServer::handle(const char* str)
 		}
 	}
 
-	Cell cell ;
+	TemplateArg arg ;
+	arg.isInt = isHex ;
+	arg.Int = 0 ;
 	if ( isHex )
-		sscanf( str, "%x", &cell.Int );
+		sscanf( str, "%x", &arg.Int );
 	else
-		cell.Str = strdup(str) ;
+		arg.Str = str ;
 
-	m_oDataStack.push( cell ) ;
+	args.push_back( arg ) ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Store parameters specified for a function placeholder in XML
+/// @brief Parse the parameters specified for a function placeholder in XML
 /// @param str	Parameters string
+/// @param args	Parameters, in the order they are pushed on the data stack
 ////////////////////////////////////////////////////////////////////////////////
-void ScriptServer::prepareStack(const char* str )
+void ScriptServer::prepareStack(const char* str, std::vector<TemplateArg>& args )
 {
+	if ( str==NULL || *str=='\0' ) return ;	// no argument
 	std::ostringstream token ;
 	const char*p=str;
 	while ( p!=NULL )
@@ -2157,7 +3193,7 @@ void ScriptServer::prepareStack(const char* str )
 
 		if ( *p == '\0' || *p == ' ' )
 		{
-			handle( token.str().c_str() );
+			handle( token.str().c_str(), args );
 			token.str("");
 		}
 		else
@@ -2226,31 +3262,29 @@ bool ScriptServer::load(std::stringstream& out )
 {
 	
 	if ( m_oDataStack.empty() ) return false ;
-	int offset,start ;
+	int offset = 0, start ;
 
 	if ( m_oDataStack.size() >= 2 )
 	{      offset = m_oDataStack.top().Int ; m_oDataStack.pop() ; }
 	const char* var = m_oDataStack.top().Str ; m_oDataStack.pop();
-	if ( g_oCfg.StorageMap.find( (char*)var ) == g_oCfg.StorageMap.end() )
+	int slot = g_oCfg.Storage.Find( var ) ;
+	if ( !g_oCfg.Storage.Has( slot ) )
 	{
 		LOG_ERROR("Error - LOAD: refence to undefined variable:%s\n",(char*)var );
 		return false;
 	}
 
-	sscanf( g_oCfg.StorageMap[ (char*)var ], "%x", &start);
-	start+=offset ;
-	if ( g_oCfg.StorageMap.find( (char*)var ) != g_oCfg.StorageMap.end() )
-	{
-		out << std::hex << start ;
-		LOG_INFO("Loaded:%x\n",start );
-		return true ;
-	}
-
-	return false ;
+	long value ;
+	g_oCfg.Storage.Number( slot, value ) ;
+	start = (int)value + offset ;
+	out << std::hex << start ;
+	LOG_INFO("Loaded:%x\n",start );
+	return true ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Get the value of a placeholder exported from ss.ini.
+/// @remarks The value comes from the in-memory copy of [EXPORT]; see CConfigCache.
 ////////////////////////////////////////////////////////////////////////////////
 bool ScriptServer::GetConfig(std::stringstream& out)
 {
@@ -2259,185 +3293,66 @@ bool ScriptServer::GetConfig(std::stringstream& out)
 
 	const char* met = m_oDataStack.top().Str; m_oDataStack.pop();
 
-	CSimpleIniA ini(false, true, true) ;
-	ini.LoadFile("../../Config/ss.ini") ;
-	const char * rv = ini.GetValue("export", met) ;
-	out << rv ;
+	const char * rv = m_oConfig.Get(met) ;
+	if ( rv )
+		out << rv ;
 	
 	return false ;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Get the value of a stored id and return it to data of the wait tag for comparison- Kiran J
+/// @param data	Operation on the value, like +1, or empty; overwritten with
+/// the first w.size digits of the value, or with the result of the operation
+/// in upper case, left padded with zeros to w.size
+/// @remarks The operation works on the number kept with the value, parsed
+/// from its text only when the text was saved as such.
 ////////////////////////////////////////////////////////////////////////////////
 bool ScriptServer::getStoredCompare(struct Tagwait&w, char *data)
 {
-	
-	int srcCommas, dstCommas,inType,counter=0 ;
-long int matchdata,newvalue,iddata;
-char operator1;
-int ll=strlen(data);
-	char* src,*OrigData=new char[ll];
-       /*            while(counter<ll)
-{
-OrigData[counter]=data [counter];
-counter++;
-}
-OrigData[counter]=0;
-
-counter=0;*/
-strcpy(OrigData,data);
-LOG_INFO("OrigData1=%s", OrigData) ;
-		if ( w.id )
-		{
-			if ( g_oCfg.StorageMap.find( w.id ) == g_oCfg.StorageMap.end() )
-			{
-				LOG_INFO("ERROR: undefined reference to ID:%s. It was not saved previously\n", w.id ) ;
-				//Modified By Honeywell - RK Praveen
-				//return false to true - change is made to continue for failcontinue to pass though buffer is empty
-				return false ;
-			}
-			src = g_oCfg.StorageMap[w.id] ; // check to see if the id is in the map
-			LOG_INFO("\tLoad Saved content:[id:%s]<%s>\n", w.id, g_oCfg.StorageMap[w.id]) ;
-                   while(counter<w.size)
-{
-data[counter]=src [counter];
-counter++;
-}
-
-data[counter]=0;
-if(strlen(OrigData)!=0)
-{
-LOG_INFO("OrigData2=%s", OrigData) ;
-sscanf( OrigData, "%c%lx",&operator1,&matchdata );
-LOG_INFO("Operator=%c Value=%lx", operator1,matchdata) ;
-sscanf(data, "%lx",&iddata);
-switch(operator1)
-{
-case '+':
-newvalue=iddata+matchdata;
-break;
-case '-':
-newvalue=iddata-matchdata;
-break;
-case '*':
-newvalue=iddata*matchdata;
-break;
-case '/':
-newvalue=iddata/matchdata;
-break;
-default:
-LOG_INFO("Error:Not a valid operator%c ", operator1) ;
-break;
-}
-//itoa(newvalue,data);
-//sscanf(newvalue, "%s",data);
-sprintf(data, "%lx", newvalue);
-if(strlen(data)<w.size)
-{
-int k=w.size-strlen(data),j=0,n=0;
-char temp[w.size+1];
-while(j<k)
-{
-temp[j]='0';
-j++;
-}
-while(j<w.size)
-{
-temp[j]=data[n];
-j++;
-n++;
-}
-temp[j]=0;
-memcpy(data,temp,w.size);
-
-}
-int kk=0;
-	while(data[kk]!='\0')
+	std::string OrigData(data) ;
+	LOG_INFO("OrigData1=%s", OrigData.c_str()) ;
+	if ( !w.id )
 	{
-		if(data[kk]>=97) data[kk]-=32;
-		kk++;
+		for ( char* c = data; *c; ++c )
+			if ( *c >= 'a' ) *c -= 'a' - 'A' ;
+		return true ;
 	}
-
-}
-//LOG_INFO("\tCopied compare data from id:  Data:%s \n",data) ;
-
-
-			return true;
-
-		}
-int kk=0;
-	while(data[kk]!='\0')
+	if ( !g_oCfg.Storage.Has( w.slot ) )
 	{
-		if(data[kk]>=97) data[kk]-=32;
-		kk++;
+		LOG_INFO("ERROR: undefined reference to ID:%s. It was not saved previously\n", w.id ) ;
+		//Modified By Honeywell - RK Praveen
+		//return false to true - change is made to continue for failcontinue to pass though buffer is empty
+		return false ;
 	}
+	const char* src = g_oCfg.Storage.Get( w.slot ) ;
+	LOG_INFO("\tLoad Saved content:[id:%s]<%s>\n", w.id, src) ;
+	size_t width = w.size > 0 ? w.size : 0 ;
+	size_t len = strnlen( src, width ) ;
+	memcpy( data, src, len ) ;
+	data[len] = 0 ;
+	if ( OrigData.empty() )
+		return true ;
 
-//data=strupr(data);
-//LOG_INFO("\tCopied compare data from id:  Data:%s \n",data) ;
-
-}
-
-////////////////////////////////////////////////////////////////////////////////
-/// @brief Get the binary value of Hexadecimal character in half byte- Kiran J
-////////////////////////////////////////////////////////////////////////////////
-char* ScriptServer::getBinary(char value)
-{
-char *ch;
-switch(value)
-{
-case '0':
-memcpy(ch,"0000",4);
-break;
-case '1':
-memcpy(ch,"0001",4);
-break;
-case '2':
-memcpy(ch,"0010",4);
-break;
-case '3':
-memcpy(ch,"0011",4);
-break;
-case '4':
-memcpy(ch,"0100",4);
-break;
-case '5':
-memcpy(ch,"0101",4);
-break;
-case '6':
-memcpy(ch,"0110",4);
-break;
-case '7':
-memcpy(ch,"0111",4);
-break;
-case '8':
-memcpy(ch,"1000",4);
-break;
-case '9':
-memcpy(ch,"1001",4);
-break;
-case 'A':
-memcpy(ch,"1010",4);
-break;
-case 'B':
-memcpy(ch,"1011",4);
-break;
-case 'C':
-memcpy(ch,"1100",4);
-break;
-case 'D':
-memcpy(ch,"1101",4);
-break;
-case 'E':
-memcpy(ch,"1110",4);
-break;
-case 'F':
-memcpy(ch,"1111",4);
-break;
-
-}
-//LOG_INFO( "Ch=[%s] value=%c\n", ch,value) ;
-return ch;
+	LOG_INFO("OrigData2=%s", OrigData.c_str()) ;
+	char op = 0 ;
+	long operand = 0, value, result ;
+	sscanf( OrigData.c_str(), "%c%lx", &op, &operand ) ;
+	LOG_INFO("Operator=%c Value=%lx", op, operand) ;
+	/* a value wider than the compare is cut to its first digits */
+	if ( src[len] || !g_oCfg.Storage.Number( w.slot, value ) )
+		value = strtoul( data, NULL, 16 ) ;
+	switch ( op )
+	{
+	case '+': result = value + operand ; break ;
+	case '-': result = value - operand ; break ;
+	case '*': result = value * operand ; break ;
+	case '/': result = value / operand ; break ;
+	default:
+		LOG_INFO("Error:Not a valid operator%c ", op) ;
+		result = value ;
+		break ;
+	}
+	sprintf( data, "%0*lX", (int)width, result ) ;
+	return true ;
 }
-
-
@@ -6,11 +6,19 @@
 #include <istream>
 #include <sstream>
 #include <stack>
+#include <set>
+#include <string>
 
 #include "Attribs.h"
 #include "Tags.h"
 #include "Misc.h"
 #include "Csv.h"
+#include "Transport.h"
+#include "Scheduler.h"
+#include "ConfigCache.h"
+#include "ScriptCache.h"
+#include "MsgView.h"
+#include "UdoDownload.h"
 
 #include "tinyxml.h"
 
@@ -22,27 +30,173 @@ struct Cell {
 };
 
 
+class ScriptServer ;
+typedef bool(ScriptServer::*PlaceholderFn)(std::stringstream& out);
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Argument of a placeholder callback, parsed once.
+/// @remarks Hex tokens are passed as Int, the others as Str.
+////////////////////////////////////////////////////////////////////////////////
+struct TemplateArg {
+	bool	isInt ;
+	int	Int ;
+	std::string Str ;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Placeholder of a Template: the callback and its arguments.
+////////////////////////////////////////////////////////////////////////////////
+struct TemplateSlot {
+	size_t	at ;			///< position in Template::text of the callback output
+	PlaceholderFn fn ;
+	std::vector<TemplateArg> args ;	///< pushed on the data stack, in order
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A string with {placeholders}, parsed once by
+/// ScriptServer::compileTemplate() and expanded by expandTemplate().
+////////////////////////////////////////////////////////////////////////////////
+struct Template {
+	std::string text ;		///< literal spans, placeholders removed
+	std::vector<TemplateSlot> slots ;
+	bool	complete ;		///< false when a bad placeholder cut the text short
+	Template() : complete(false) {}
+};
+
+
+/**
+ * @see ScriptServer::evalWait
+ * outcome of the check of one Wait/Match element
+ */
+enum MATCH_CHECK
+{
+	CHECK_OK,
+	CHECK_LAYER,		///< the message type has no such layer
+	CHECK_OP,		///< unknown operator
+	CHECK_TYPE,		///< message of another type
+	CHECK_MALFORMED,	///< message shorter than the layer
+	CHECK_BITSIZE,		///< mask/value or bit pattern that does not fit the size
+	CHECK_DIFF,		///< data differs
+	CHECK_BEYOND		///< data matches but the field goes on (typechk)
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check of a Wait/Match element, kept until it is reported.
+////////////////////////////////////////////////////////////////////////////////
+struct MatchEval {
+	int	check ;			///< MATCH_CHECK
+	int	field ;			///< commas before the layer
+	const char *p ;			///< layer of the message
+	const unsigned char *bits ;	///< decoded mask and value, or data, NULL when none
+	std::string expanded ;		///< layer with its placeholders expanded, seldom used
+};
+
+
 struct Field {
 	const char * name ;
 	int offset ;
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A message as it was last sent, kept for the retry.
+////////////////////////////////////////////////////////////////////////////////
+struct SentLine {
+	Params	params ;
+	std::string line ;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A step of a parallel window (see ScriptServer::runParallel).
+////////////////////////////////////////////////////////////////////////////////
+struct Step {
+	int	no ;
+	Params	params ;
+	char	*outLine ;
+	int	outLineSz ;
+	Datagram rmt ;
+	CMsgView rx ;		///< fields of rmt
+	int	timeout ;
+	long long deadline ;
+	bool	retried ;
+	bool	done ;
+	Step()
+	: no(0), outLine(NULL), outLineSz(0)
+	, timeout(0), deadline(0), retried(false), done(false)
+	{
+	}
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A Wait/Match record parsed at load time.
+/// @remarks offset, size and data are set when they hold placeholders, or
+/// when the data is compared to a saved id; they are resolved when the step
+/// runs. Otherwise w holds the final values.
+////////////////////////////////////////////////////////////////////////////////
+struct CompiledWait {
+	Tagwait	w ;
+	char	*offset ;
+	char	*size ;
+	char	*data ;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A CSV step parsed and checked before the script runs.
+/// @see ScriptServer::compileStep
+////////////////////////////////////////////////////////////////////////////////
+struct CompiledStep {
+	int	no ;
+	std::string text ;		///< CSV step, for the log
+	std::string desc ;
+	const char *rfNode ;
+	char	host[256] ;
+	int	ackLoggerPort ;
+	int	backbonePort ;
+	int	msgType ;
+	int	timeout ;
+	int	policy ;
+	std::string loopText ;		///< loop holding placeholders, expanded per run
+	struct loop_spec loop ;
+	std::vector<CompiledWait> waits ;
+	std::vector<TagModify> saves ;
+	std::vector<TagModify> copies ;
+	std::string outLine ;		///< message, placeholders not expanded
+	CompiledStep()
+	: no(0), rfNode(NULL), ackLoggerPort(0), backbonePort(0)
+	, msgType(MSG_UNKNOWN), timeout(0), policy(0)
+	{
+		host[0] = 0 ;
+	}
+};
+
+
 
 class ScriptServer {
 public:
 	ScriptServer( ) ;
-	int RunScript(std::istream*&in) ;
+	~ScriptServer( ) ;
+	int RunScript(std::istream* in, CScriptCache& cache) ;
 
 	void GenerateUdoTest(const char *firmwareFileName, int maxBlockSize, int startOffset, int processingTime);
+	bool RunUdoDownload(const char *firmwareFileName, int maxBlockSize, int startOffset, int processingTime, int window
+			, std::vector<UdoTarget> targets = std::vector<UdoTarget>());
 
 private:
+	bool readUdoConfig(UdoConfig& cfg, std::vector<UdoTarget>& targets);
 	void generateWaitElementExecResp(TiXmlElement *msg, char *processingTimeBuf, char *udoObjIDBuf);
 	void generateWaitElementsIdSfc(TiXmlElement *msg, char *processingTimeBuf, char *reqIDBuf);
 	void generateElementsAfterApduUdo(TiXmlElement *msg, const char *ssIpv6, const char *dutUdoIpv6,
 			const char *p_udoPort, const char *p_securityPolicy);
 
-	void updateTAIDesync(char * mesg);
+	void updateTAIDesync(const CMsgView& mesg);
 
 protected:
 	bool  TaiOffset( std::stringstream& out ) ;
@@ -50,34 +204,73 @@ protected:
 	bool  load( std::stringstream& out) ;
 	bool  GetConfig( std::stringstream& out ) ;
 	bool  didxExtdluint( std::stringstream& out ) ;
-       char* getBinary(char value);
-
-	bool wait(Params& params, char*& line) ;
-	MATCH_TYPE matchLiteral(const char*p, struct Tagwait&w, int policy);
-	MATCH_TYPE matchNativeType(const char*p, Tagwait&w, int policy);
-	MATCH_TYPE match(char*, struct Tagwait& w, int policy) ;
-	bool loadAll(std::vector<struct TagModify>& mvec, char* src, char*& dst, int type, int myType,int& dstSz ) ;
-	bool saveAll(std::vector<struct TagModify>& mvec, char* src, int type) ;
-	bool readParams(struct Params& params, char*line, char *& outLine,int & outLineSz) ;
-	void prepareStack(const char* str );
-	void handle(const char* str);
+
+	int  runParallel(const std::vector<CompiledStep>& steps) ;
+	int  runWindow(std::vector<Step>& window) ;
+	int  completeStep(Step& st) ;
+	void releaseWindow(std::vector<Step>& window) ;
+	int  finishStep(Params& params, char*& outLine, int& outLineSz, const CMsgView& rx) ;
+	bool sendPaced(Params& params, const char* outLine) ;
+	bool sendBatched(Params& params, const char* outLine) ;
+	bool resend(SentLine& sent) ;
+
+	bool wait(Params& params, Datagram& in, CMsgView& rx) ;
+	MATCH_TYPE matchAll(Params& params, Datagram& in, CMsgView& rx) ;
+	bool noResponse(Params& params, int timeout) ;
+	void compileMatch(Params& params) ;
+	MATCH_TYPE runMatch(Params& params, const CMsgView& rx) ;
+	int  evalWait(const Tagwait& w, int field, const unsigned char* bits, const CMsgView& rx, MatchEval& e) ;
+	int  checkWait(const Tagwait& w, const CMsgView& rx, MatchEval& e) ;
+	MATCH_TYPE outcome(const Tagwait& w, int check, int policy) ;
+	MATCH_TYPE reportWait(const Tagwait& w, const CMsgView& rx, const MatchEval& e, int policy) ;
+	bool loadAll(std::vector<struct TagModify>& mvec, const CMsgView& rx, char*& dst, int myType,int& dstSz ) ;
+	bool saveAll(std::vector<struct TagModify>& mvec, const CMsgView& rx, int type) ;
+	bool compileScript(std::istream& in, std::vector<CompiledStep>& steps) ;
+	bool compileStep(CompiledStep& cs, int no, const std::string& line, std::set<std::string>& saved) ;
+	bool loadScript(const CScriptCache& cache, std::vector<CompiledStep>& steps) ;
+	void storeScript(CScriptCache& cache, const std::vector<CompiledStep>& steps) ;
+	bool checkLayer(int no, const char* what, const char* layer, int msgType, int& type) ;
+	bool bindStep(const CompiledStep& cs, struct Params& params, char *& outLine, int & outLineSz) ;
+	int  resolveInt(const char* spec, char*& expanded) ;
+	std::string intPlaceholder(const char* spec, int& Cnst) ;
+	bool foldInt(const char* spec, int& value, char*& expanded) ;
+	void reverseBytes(char* data) ;
+	bool maskBytes(const Tagwait& w, std::vector<unsigned char>& out) ;
+	void prepareStack(const char* str, std::vector<TemplateArg>& args );
+	void handle(const char* str, std::vector<TemplateArg>& args);
 
 protected:
 	bool getOpType( CCsv&, int&) ;
+	bool getOpType( const char*, int&) ;
 	const char* getMsgType(int) ;
 	bool getLayerType( CCsv&, int& type) ;
+	bool getLayerType( const char*, int& type) ;
        bool getStoredCompare(struct Tagwait&w, char *data);
 	bool getPolicyType(const char*policy, int& type) ;
 	bool getLoop( const char*loop, struct loop_spec& ) ;
-	bool getRfNode(const char*rfNode, char*host, int& ackLoggerPort,
-			int&backbonePort) ;
+	bool getRfNode(const char*rfNode, const char*& name, char*host,
+			int& ackLoggerPort, int&backbonePort) ;
 	bool parseConfig( ) ;
 	bool expandPlaceHolders(const char* line, std::stringstream&) ;
+	bool compileTemplate(const char* line, Template& t) ;
+	bool parsePlaceholder(const char*& it, const char* end, TemplateSlot& slot) ;
+	void expandTemplate(const Template& t, std::stringstream& out) ;
+	void callSlot(const TemplateSlot& slot, std::stringstream& out) ;
+	bool isPure(PlaceholderFn fn) const ;
+	bool foldPlaceHolders(const char* line, std::string& out) ;
 
 protected:
-	typedef bool(ScriptServer::*func_ptr)(std::stringstream& out);
+	typedef PlaceholderFn func_ptr;
 	std::map<const char*, func_ptr, cmp_str> placeholderCallbacks ;
 	std::stack<Cell> m_oDataStack ;
+	CReactor      m_oReactor ;
+	CUdpTransport m_oTransport ;
+	CSendScheduler m_oScheduler ;
+	CConfigCache  m_oConfig ;
+	SentLine      m_oLastSent ;
+	std::map<const char*, SentLine, cmp_str> m_oLastSentByNode ;
+	bool          m_bRetry ;
+	std::vector<MatchEval> m_vMatchEval ;	///< by element, reused from one message to the next
 } ;
 
 #endif	/* _SCRIPT_SERVER_H_ */
@@ -0,0 +1,241 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Storage.h"
+#include "Flog.h"
+
+
+CStorage::CStorage()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Slot of an id, given to it on the first call.
+////////////////////////////////////////////////////////////////////////////////
+int CStorage::Intern( const char* id )
+{
+	std::map<std::string, int>::iterator it = m_oSlots.find(id) ;
+	if ( it != m_oSlots.end() )
+		return it->second ;
+	int slot = m_vNames.size() ;
+	m_vNames.push_back(id) ;
+	m_vSlots.push_back( Slot() ) ;
+	m_oSlots[id] = slot ;
+	return slot ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Slot of an id known by its name only, as in a {LOAD id} placeholder.
+/// @retval -1 when no step saves it
+////////////////////////////////////////////////////////////////////////////////
+int CStorage::Find( const char* id ) const
+{
+	std::map<std::string, int>::const_iterator it = m_oSlots.find(id) ;
+	return it == m_oSlots.end() ? -1 : it->second ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Value of a slot.
+/// @retval NULL when nothing was saved in it
+/// @remarks The value stays valid until the next Set() or Clear(). The text
+/// of a number is written in the room SetNumber() kept for it.
+////////////////////////////////////////////////////////////////////////////////
+char* CStorage::Get( int slot )
+{
+	if ( !Has(slot) )
+		return NULL ;
+	Slot& s = m_vSlots[slot] ;
+	if ( !s.text )
+	{
+		snprintf( &m_vArena[s.at], s.room + 1, "%lX", s.value ) ;
+		s.text = true ;
+	}
+	return &m_vArena[s.at] ;
+}
+
+
+void CStorage::Set( int slot, const char* value, size_t len )
+{
+	if ( slot < 0 || (size_t)slot >= m_vSlots.size() )
+		return ;
+	Slot& s = m_vSlots[slot] ;
+	reserve( s, len ) ;
+	memcpy( &m_vArena[s.at], value, len ) ;
+	m_vArena[s.at + len] = 0 ;
+	s.set = true ;
+	s.loaded = false ;
+	s.text = true ;
+	s.number = UNPARSED ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Value of a slot as a hex number, read as sscanf("%lx") would.
+/// @retval false when nothing was saved in it, or its text is not a number
+////////////////////////////////////////////////////////////////////////////////
+bool CStorage::Number( int slot, long& value )
+{
+	if ( !Has(slot) )
+		return false ;
+	Slot& s = m_vSlots[slot] ;
+	if ( s.number == UNPARSED )
+	{
+		const char* text = &m_vArena[s.at] ;
+		char* end ;
+		s.value = (long)strtoul( text, &end, 16 ) ;
+		s.number = end == text ? NOT_NUMBER : NUMBER ;
+	}
+	value = s.value ;
+	return s.number == NUMBER ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Save a number, whose text is the upper case hex printf("%lX") writes.
+////////////////////////////////////////////////////////////////////////////////
+void CStorage::SetNumber( int slot, long value )
+{
+	if ( slot < 0 || (size_t)slot >= m_vSlots.size() )
+		return ;
+	Slot& s = m_vSlots[slot] ;
+	reserve( s, 2 * sizeof(long) ) ;
+	s.set = true ;
+	s.loaded = false ;
+	s.text = false ;
+	s.number = NUMBER ;
+	s.value = value ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Make room for len bytes and a NUL, in place when the slot has it.
+////////////////////////////////////////////////////////////////////////////////
+void CStorage::reserve( Slot& s, size_t len )
+{
+	if ( s.set && len <= s.room )
+		return ;
+	s.at = m_vArena.size() ;
+	s.room = len ;
+	m_vArena.resize( s.at + len + 1 ) ;
+}
+
+
+void CStorage::Clear()
+{
+	m_vArena.clear() ;
+	for ( size_t i = 0; i < m_vSlots.size(); ++i )
+		m_vSlots[i] = Slot() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read the values of a snapshot written by Store().
+/// @retval false when there is no snapshot, or it is not one; no value is
+/// loaded then
+/// @remarks A value already saved by this run is kept.
+////////////////////////////////////////////////////////////////////////////////
+bool CStorage::Load( const char* fileName )
+{
+	int fd = open( fileName, O_RDONLY ) ;
+	if ( fd == -1 )
+	{
+		LOG_INFO( "No storage snapshot %s: %s\n", fileName, strerror(errno) ) ;
+		return false ;
+	}
+	struct stat st ;
+	if ( fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(StorageSnapshotHeader) )
+	{
+		close(fd) ;
+		LOG_WARN( "Storage snapshot %s is not valid\n", fileName ) ;
+		return false ;
+	}
+	size_t size = st.st_size ;
+	void* map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 ) ;
+	close(fd) ;
+	if ( map == MAP_FAILED )
+	{
+		LOG_ERROR( "Error - mmap %s: %s\n", fileName, strerror(errno) ) ;
+		return false ;
+	}
+
+	const StorageSnapshotHeader* h = (const StorageSnapshotHeader*)map ;
+	const StorageSnapshotEntry* e = (const StorageSnapshotEntry*)(h + 1) ;
+	const char* text = (const char*)(e + h->values) ;
+	bool ok = h->magic == STORAGE_SNAPSHOT_MAGIC && h->version == STORAGE_SNAPSHOT_VERSION
+		&& h->values <= size / sizeof(StorageSnapshotEntry)
+		&& sizeof(*h) + (size_t)h->values * sizeof(*e) + h->textSize == size
+		&& ( !h->textSize || text[h->textSize - 1] == 0 ) ;
+	for ( unsigned int i = 0; ok && i < h->values; ++i )
+		ok = e[i].id < h->textSize && e[i].value < h->textSize ;
+	if ( !ok )
+	{
+		LOG_WARN( "Storage snapshot %s is not valid\n", fileName ) ;
+		munmap( map, size ) ;
+		return false ;
+	}
+
+	for ( unsigned int i = 0; i < h->values; ++i )
+	{
+		int slot = Intern( text + e[i].id ) ;
+		if ( Saved(slot) )
+			continue ;
+		Set( slot, text + e[i].value, strlen(text + e[i].value) ) ;
+		m_vSlots[slot].loaded = true ;
+	}
+	LOG_INFO( "Storage snapshot %s: %u values loaded\n", fileName, h->values ) ;
+	munmap( map, size ) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write every value, loaded or saved by this run, to a snapshot.
+/// @retval false when the snapshot could not be written
+/// @remarks The file is written aside and renamed, so that a concurrent run
+/// reads either the old or the new snapshot.
+////////////////////////////////////////////////////////////////////////////////
+bool CStorage::Store( const char* fileName )
+{
+	std::vector<StorageSnapshotEntry> entries ;
+	std::string text ;
+	for ( size_t slot = 0; slot < m_vSlots.size(); ++slot )
+	{
+		if ( !Has(slot) )
+			continue ;
+		StorageSnapshotEntry e ;
+		e.id = text.size() ;
+		text.append( m_vNames[slot].c_str(), m_vNames[slot].size() + 1 ) ;
+		const char* value = Get(slot) ;
+		e.value = text.size() ;
+		text.append( value, strlen(value) + 1 ) ;
+		entries.push_back(e) ;
+	}
+
+	StorageSnapshotHeader h ;
+	memset( &h, 0, sizeof(h) ) ;
+	h.magic = STORAGE_SNAPSHOT_MAGIC ;
+	h.version = STORAGE_SNAPSHOT_VERSION ;
+	h.values = entries.size() ;
+	h.textSize = text.size() ;
+
+	std::string tmp = std::string(fileName) + ".tmp" ;
+	FILE* f = fopen( tmp.c_str(), "wb" ) ;
+	if ( !f )
+	{
+		LOG_WARN( "Unable to write storage snapshot %s: %s\n", tmp.c_str(), strerror(errno) ) ;
+		return false ;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& ( entries.empty() || fwrite(&entries[0], sizeof(StorageSnapshotEntry), entries.size(), f) == entries.size() )
+		&& fwrite(text.data(), 1, text.size(), f) == text.size() ;
+	ok = (fclose(f) == 0) && ok ;
+	if ( !ok || rename(tmp.c_str(), fileName) == -1 )
+	{
+		LOG_WARN( "Unable to write storage snapshot %s: %s\n", fileName, strerror(errno) ) ;
+		unlink( tmp.c_str() ) ;
+		return false ;
+	}
+	LOG_INFO( "Storage snapshot %s: %u values stored\n", fileName, h.values ) ;
+	return true ;
+}
@@ -0,0 +1,96 @@
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/// "SSS1"
+#define STORAGE_SNAPSHOT_MAGIC	0x31535353
+/// bump when the layout of the file changes
+#define STORAGE_SNAPSHOT_VERSION	1
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Header of a storage snapshot file.
+/// @remarks Followed by one StorageSnapshotEntry per value and by the text:
+/// each id and each value, NUL terminated. The file holds no pointers and can
+/// be mapped anywhere.
+////////////////////////////////////////////////////////////////////////////////
+struct StorageSnapshotHeader {
+	unsigned int magic ;
+	unsigned int version ;
+	unsigned int values ;
+	unsigned int textSize ;
+} ;
+
+struct StorageSnapshotEntry {
+	unsigned int id ;	///< offset of the id in the text
+	unsigned int value ;	///< offset of the value in the text
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Values saved by the Save elements of a script, by id.
+/// @remarks The ids are interned when the script is compiled: each one gets
+/// a small integer, and Has(), Get() and Set() index an array with it. The
+/// values of a run are kept one after the other in an arena; a value set
+/// again is written over the old one when it fits, so a run that keeps
+/// saving the same ids does not keep growing. Clear() drops the values for a
+/// new run and keeps the ids and the memory.
+/// A value is also a hex number for the arithmetic saves and the compares.
+/// Each side is worked out from the other the first time it is asked for:
+/// Number() parses the text once, and the text of SetNumber() is written
+/// only when Get() needs it.
+/// Load() and Store() keep the values in a file between runs, for the
+/// scripts of a campaign that use what the previous ones saved. A loaded
+/// value may be saved again by the run: Saved() tells it from one the run
+/// saved itself.
+////////////////////////////////////////////////////////////////////////////////
+class CStorage {
+public:
+	CStorage() ;
+
+public:
+	int Intern( const char* id ) ;
+	int Find( const char* id ) const ;
+	const char* Name( int slot ) const { return m_vNames[slot].c_str() ; }
+
+	bool Has( int slot ) const { return slot >= 0 && (size_t)slot < m_vSlots.size() && m_vSlots[slot].set ; }
+	bool Saved( int slot ) const { return Has(slot) && !m_vSlots[slot].loaded ; }
+	char* Get( int slot ) ;
+	void Set( int slot, const char* value, size_t len ) ;
+	void Set( int slot, const std::string& value ) { Set( slot, value.data(), value.size() ) ; }
+	bool Number( int slot, long& value ) ;
+	void SetNumber( int slot, long value ) ;
+	void Clear() ;
+
+	bool Load( const char* fileName ) ;
+	bool Store( const char* fileName ) ;
+
+protected:
+	enum { UNPARSED, NUMBER, NOT_NUMBER } ;
+
+	struct Slot {
+		size_t	at ;	///< value at m_vArena[at], NUL terminated
+		size_t	room ;	///< bytes reserved for it, the NUL not counted
+		bool	set ;
+		bool	loaded ;	///< set by Load(), not saved by this run
+		bool	text ;	///< false until the text of a SetNumber() is written
+		int	number ;	///< UNPARSED, NUMBER when value holds it, NOT_NUMBER
+		long	value ;
+		Slot() : at(0), room(0), set(false), loaded(false), text(false), number(UNPARSED), value(0) {}
+	} ;
+
+protected:
+	void reserve( Slot& s, size_t len ) ;
+
+protected:
+	std::vector<std::string> m_vNames ;	///< id of each slot
+	std::map<std::string, int> m_oSlots ;	///< slot of each id, for Intern() and Find()
+	std::vector<Slot> m_vSlots ;
+	std::vector<char> m_vArena ;
+} ;
+
+#endif	/* _STORAGE_H_ */
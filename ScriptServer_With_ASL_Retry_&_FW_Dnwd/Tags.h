@@ -20,17 +20,35 @@ struct Tagwait
 	char *offset_char;
 	char *size_char;
 	char	*data ;
+	char	*mask ;	///< mask of a mask/value element, the value being the data
        char   *id;
+	int	slot ;	///< id interned in g_oCfg.Storage, -1 when none
        int   srcSize;
        Modpos	src;
 } ;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Instruction of a match program: where a Wait/Match element looks.
+/// @see ScriptServer::compileMatch
+////////////////////////////////////////////////////////////////////////////////
+struct MatchOp
+{
+	unsigned tag ;	///< index of the element in Params::WaitVec, i.e. script order
+	int	field ;	///< commas before the layer, -1 when the layout has no such layer
+	int	offset ;
+	int	bits ;	///< decoded mask then value, or data, in MatchProgram::bits; -1 when none
+} ;
+
+
 struct TagModify
 {
 	int	size ;
        char *operation;
+	char	op ;	///< + - * or / of the operation, 0 when none
+	long	operand ;	///< hex number of the operation
 	char	*id ;
+	int	slot ;	///< id interned in g_oCfg.Storage, -1 when none
 	Modpos	src ;
 	Modpos	dst ;
 };
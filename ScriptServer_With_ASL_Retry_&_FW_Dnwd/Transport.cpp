@@ -0,0 +1,453 @@
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+
+#include "Transport.h"
+
+/// datagrams kept per ackLogger port before the oldest ones are dropped
+#define RX_QUEUE_MAX	256
+
+
+CBufferPool::CBufferPool( unsigned slots, unsigned slotSz )
+	: m_nSlotSz(slotSz)
+{
+	m_pSlab = (char*)malloc( (size_t)slots * slotSz ) ;
+	m_oFree.reserve( slots ) ;
+	for ( int i = slots - 1; i >= 0; --i )
+		m_oFree.push_back( i ) ;
+}
+
+
+CBufferPool::~CBufferPool()
+{
+	free( m_pSlab ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Take a free buffer.
+/// @retval buffer index, -1 when the pool is exhausted
+////////////////////////////////////////////////////////////////////////////////
+int CBufferPool::Acquire()
+{
+	if ( m_oFree.empty() )
+		return -1 ;
+	int slot = m_oFree.back() ;
+	m_oFree.pop_back() ;
+	return slot ;
+}
+
+
+void CBufferPool::Release( int slot )
+{
+	if ( slot >= 0 )
+		m_oFree.push_back( slot ) ;
+}
+
+
+CUdpTransport::CUdpTransport( CReactor& reactor )
+	: m_rReactor(reactor)
+	, m_oPool(RX_SLOTS, RX_SLOT_SZ)
+{
+	memset( m_aMsgs, 0, sizeof(m_aMsgs) ) ;
+}
+
+
+CUdpTransport::~CUdpTransport()
+{
+	Close() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Open the transmit socket of an RF node.
+/// @param rfNode	RF node name, as found in ss.ini [RF_NODES]
+/// @param host		BBR address
+/// @param backbonePort	Port used both as source and destination port
+/// @retval false when the socket could not be created or bound
+////////////////////////////////////////////////////////////////////////////////
+bool CUdpTransport::OpenTx( const char* rfNode, const char* host, int backbonePort )
+{
+	if ( m_oTx.find(rfNode) != m_oTx.end() )
+		return true ;
+
+	TxSocket tx ;
+	memset( &tx.peer, 0, sizeof(tx.peer) ) ;
+	tx.peer.sin_family = AF_INET ;
+	tx.peer.sin_port = htons(backbonePort) ;
+	if ( 0 == inet_aton(host, &tx.peer.sin_addr) )
+	{
+		LOG_ERROR( "Error - inet_aton(host:%s,port:%i) failed\n", host, backbonePort ) ;
+		return false ;
+	}
+
+	if ( (tx.fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1 )
+	{
+		LOG_ERROR( "Error - socket(node:%s): %s\n", rfNode, strerror(errno) ) ;
+		return false ;
+	}
+	/// several nodes may share the same backbone port
+	int on = 1 ;
+	setsockopt( tx.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) ) ;
+
+	struct sockaddr_in servaddr ;
+	bzero(&servaddr, sizeof(servaddr)) ;
+	servaddr.sin_family = AF_INET ;
+	servaddr.sin_addr.s_addr = htonl(INADDR_ANY) ;
+	servaddr.sin_port = htons(backbonePort) ;
+	if ( 0 != bind(tx.fd, (struct sockaddr *) &servaddr, sizeof(servaddr)) )
+	{
+		LOG_ERROR( "Error - Unable to bind(node:%s port:%u): %s\n", rfNode, backbonePort, strerror(errno) ) ;
+		close(tx.fd) ;
+		return false ;
+	}
+
+	m_oTx.insert( std::pair<const char*, TxSocket>(strdup(rfNode), tx) ) ;
+	LOG_DEBUG( "TX socket open: [node:%s] [host:%s] [port:%d]\n", rfNode, host, backbonePort ) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get the transmit socket of an RF node.
+/// @retval NULL when no socket was opened for the node
+////////////////////////////////////////////////////////////////////////////////
+TxSocket* CUdpTransport::Tx( const char* rfNode )
+{
+	if ( !rfNode ) return NULL ;
+	TxMap::iterator it = m_oTx.find(rfNode) ;
+	return it == m_oTx.end() ? NULL : &it->second ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send one datagram to an RF node.
+/// @retval false when the node is unknown or sendto() failed
+////////////////////////////////////////////////////////////////////////////////
+bool CUdpTransport::Send( const char* rfNode, const char* buf, size_t len )
+{
+	TxSocket* tx = Tx(rfNode) ;
+	if ( !tx )
+	{
+		LOG_ERROR( "Error - no TX socket for RF_node[%s]\n", rfNode ? rfNode : "" ) ;
+		return false ;
+	}
+	if ( sendto(tx->fd, buf, len, 0, (const sockaddr*) &tx->peer, sizeof(tx->peer)) == -1 )
+	{
+		++tx->errors ;
+		LOG_ERROR( "Error - sendto(node:%s): %s\n", rfNode, strerror(errno) ) ;
+		return false ;
+	}
+	++tx->sent ;
+	tx->bytes += len ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send a run of datagrams to an RF node with as few sendmmsg() calls
+/// as possible.
+/// @param rfNode	RF node name
+/// @param bufs		Datagrams
+/// @param first	Index of the first datagram of the run in bufs
+/// @param count	Number of datagrams in the run
+/// @retval number of datagrams sent, -1 when the node is unknown
+////////////////////////////////////////////////////////////////////////////////
+int CUdpTransport::SendBatch( const char* rfNode, const std::vector<std::string>& bufs, size_t first, size_t count )
+{
+	TxSocket* tx = Tx(rfNode) ;
+	if ( !tx )
+	{
+		LOG_ERROR( "Error - no TX socket for RF_node[%s]\n", rfNode ? rfNode : "" ) ;
+		return -1 ;
+	}
+	if ( first > bufs.size() ) return 0 ;
+	if ( count > bufs.size() - first ) count = bufs.size() - first ;
+
+	size_t done = 0 ;
+	while ( done < count )
+	{
+		unsigned n = count - done < TX_BATCH ? count - done : TX_BATCH ;
+		for ( unsigned i = 0; i < n; ++i )
+		{
+			const std::string& b = bufs[first + done + i] ;
+			m_aTxIov[i].iov_base = (void*) b.data() ;
+			m_aTxIov[i].iov_len = b.length() ;
+			memset( &m_aTxMsgs[i], 0, sizeof(m_aTxMsgs[i]) ) ;
+			m_aTxMsgs[i].msg_hdr.msg_name = &tx->peer ;
+			m_aTxMsgs[i].msg_hdr.msg_namelen = sizeof(tx->peer) ;
+			m_aTxMsgs[i].msg_hdr.msg_iov = &m_aTxIov[i] ;
+			m_aTxMsgs[i].msg_hdr.msg_iovlen = 1 ;
+		}
+		int rv = sendmmsg( tx->fd, m_aTxMsgs, n, 0 ) ;
+		if ( rv == -1 )
+		{
+			if ( errno == EINTR ) continue ;
+			++tx->errors ;
+			LOG_ERROR( "Error - sendmmsg(node:%s): %s\n", rfNode, strerror(errno) ) ;
+			break ;
+		}
+		for ( int i = 0; i < rv; ++i )
+			tx->bytes += m_aTxMsgs[i].msg_len ;
+		tx->sent += rv ;
+		done += rv ;
+	}
+	return (int) done ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Open the receive socket of an ackLogger port.
+/// @param ackLoggerPort	Local port the BBR sends its responses to
+/// @retval false when the socket could not be created or bound
+/// @remarks Several RF nodes may share the same ackLogger port; the socket
+/// is opened only once.
+////////////////////////////////////////////////////////////////////////////////
+bool CUdpTransport::OpenRx( int ackLoggerPort )
+{
+	if ( m_oRx.find(ackLoggerPort) != m_oRx.end() )
+		return true ;
+
+	RxSocket rx ;
+	rx.port = ackLoggerPort ;
+	if ( (rx.fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1 )
+	{
+		LOG_ERROR( "Error - socket(port:%i): %s\n", ackLoggerPort, strerror(errno) ) ;
+		return false ;
+	}
+	int on = 1 ;
+	setsockopt( rx.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) ) ;
+	int rcvbuf = 4*1024*1024 ;
+	setsockopt( rx.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf) ) ;
+	fcntl( rx.fd, F_SETFL, fcntl(rx.fd, F_GETFL) | O_NONBLOCK ) ;
+
+	struct sockaddr_in servaddr ;
+	bzero(&servaddr, sizeof(servaddr)) ;
+	servaddr.sin_family = AF_INET ;
+	servaddr.sin_addr.s_addr = htonl(INADDR_ANY) ;
+	servaddr.sin_port = htons(ackLoggerPort) ;
+	if ( 0 != bind(rx.fd, (struct sockaddr *) &servaddr, sizeof(servaddr)) )
+	{
+		LOG_ERROR( "Error - Unable to bind(port:%u): %s\n", ackLoggerPort, strerror(errno) ) ;
+		close(rx.fd) ;
+		return false ;
+	}
+	if ( !m_rReactor.Add(rx.fd, this) )
+	{
+		close(rx.fd) ;
+		return false ;
+	}
+	m_oRx[ackLoggerPort] = rx ;
+	LOG_DEBUG( "RX socket open: [port:%d]\n", ackLoggerPort ) ;
+	return true ;
+}
+
+
+RxSocket* CUdpTransport::Rx( int ackLoggerPort )
+{
+	RxMap::iterator it = m_oRx.find(ackLoggerPort) ;
+	return it == m_oRx.end() ? NULL : &it->second ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Move every datagram pending on the socket into its queue.
+/// @retval number of datagrams read
+/// @remarks Datagrams are read in batches with recvmmsg() straight into pool
+/// buffers. When the pool runs dry the oldest datagram of the same port is
+/// recycled; when the port has nothing to recycle the datagram is discarded.
+////////////////////////////////////////////////////////////////////////////////
+int CUdpTransport::Drain( RxSocket& rx )
+{
+	int count = 0 ;
+	for ( ;; )
+	{
+		int n = 0 ;
+		for ( ; n < RX_BATCH; ++n )
+		{
+			int slot = m_oPool.Acquire() ;
+			if ( slot < 0 )
+			{
+				if ( rx.queue.empty() )
+					break ;
+				slot = rx.queue.front().slot ;
+				rx.queue.pop_front() ;
+				++rx.dropped ;
+			}
+			m_aSlots[n] = slot ;
+			m_aIov[n].iov_base = m_oPool.Buffer(slot) ;
+			m_aIov[n].iov_len  = m_oPool.SlotSize() - 1 ;
+			m_aMsgs[n].msg_hdr.msg_iov = &m_aIov[n] ;
+			m_aMsgs[n].msg_hdr.msg_iovlen = 1 ;
+			m_aMsgs[n].msg_hdr.msg_name = &m_aFrom[n] ;
+			m_aMsgs[n].msg_hdr.msg_namelen = sizeof(m_aFrom[n]) ;
+			m_aMsgs[n].msg_hdr.msg_flags = 0 ;
+		}
+		if ( !n )
+		{
+			char scratch[1] ;
+			if ( recv(rx.fd, scratch, sizeof(scratch), MSG_DONTWAIT|MSG_TRUNC) < 0 )
+				break ;
+			++rx.dropped ;
+			continue ;
+		}
+
+		int r = recvmmsg(rx.fd, m_aMsgs, n, MSG_DONTWAIT, NULL) ;
+		if ( r < 0 )
+		{
+			if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+				LOG_ERROR( "Error - recvmmsg(port:%i): %s\n", rx.port, strerror(errno) ) ;
+			r = 0 ;
+		}
+		for ( int i = 0; i < r; ++i )
+		{
+			if ( m_aMsgs[i].msg_hdr.msg_flags & MSG_TRUNC )
+			{
+				LOG_ERROR( "Error - datagram larger than %u bytes dropped (port:%i)\n", m_oPool.SlotSize() - 1, rx.port ) ;
+				m_oPool.Release( m_aSlots[i] ) ;
+				++rx.truncated ;
+				continue ;
+			}
+			enqueue( rx, m_aSlots[i], m_aMsgs[i].msg_len, m_aFrom[i] ) ;
+		}
+		for ( int i = r; i < n; ++i )
+			m_oPool.Release( m_aSlots[i] ) ;
+		count += r ;
+		if ( r < n )
+			break ;
+	}
+	return count ;
+}
+
+
+void CUdpTransport::enqueue( RxSocket& rx, int slot, size_t len, const struct sockaddr_in& from )
+{
+	Datagram d ;
+	d.slot = slot ;
+	d.data = m_oPool.Buffer(slot) ;
+	if ( len > 0 && d.data[len - 1] == '\n' )
+		--len ;
+	d.data[len] = 0 ;
+	d.len = len ;
+	d.from = from ;
+	if ( rx.queue.size() >= RX_QUEUE_MAX )
+	{
+		m_oPool.Release( rx.queue.front().slot ) ;
+		rx.queue.pop_front() ;
+		++rx.dropped ;
+	}
+	rx.queue.push_back( d ) ;
+	++rx.received ;
+}
+
+
+void CUdpTransport::DrainAll()
+{
+	for ( RxMap::iterator it = m_oRx.begin(); it != m_oRx.end(); ++it )
+		Drain( it->second ) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reactor callback: a receive socket became readable.
+////////////////////////////////////////////////////////////////////////////////
+void CUdpTransport::OnReadable( int fd )
+{
+	for ( RxMap::iterator it = m_oRx.begin(); it != m_oRx.end(); ++it )
+	{
+		if ( it->second.fd == fd )
+		{
+			Drain( it->second ) ;
+			return ;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pop the oldest queued datagram of an ackLogger port without waiting.
+/// @retval false when the queue is empty
+////////////////////////////////////////////////////////////////////////////////
+bool CUdpTransport::Pop( int ackLoggerPort, Datagram& out )
+{
+	RxSocket* rx = Rx(ackLoggerPort) ;
+	if ( !rx || rx->queue.empty() )
+		return false ;
+	out = rx->queue.front() ;
+	rx->queue.pop_front() ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pop the oldest datagram received on an ackLogger port.
+/// @param ackLoggerPort	Port to read from
+/// @param deadlineMs	Absolute time (see NowMs) after which to give up
+/// @param out		Received datagram; the caller has to Release() it
+/// @retval false when nothing was received before the deadline
+/// @remarks While waiting, the reactor keeps draining every other port too.
+////////////////////////////////////////////////////////////////////////////////
+bool CUdpTransport::Receive( int ackLoggerPort, long long deadlineMs, Datagram& out )
+{
+	RxSocket* rx = Rx(ackLoggerPort) ;
+	if ( !rx && (!OpenRx(ackLoggerPort) || !(rx = Rx(ackLoggerPort))) )
+		return false ;
+
+	Drain( *rx ) ;
+	while ( rx->queue.empty() )
+	{
+		long long left = deadlineMs - NowMs() ;
+		if ( left <= 0 )
+			return false ;
+		if ( m_rReactor.RunOnce( (int)left ) == -1 )
+			return false ;
+	}
+	out = rx->queue.front() ;
+	rx->queue.pop_front() ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Give the buffer of a popped datagram back to the pool.
+////////////////////////////////////////////////////////////////////////////////
+void CUdpTransport::Release( Datagram& d )
+{
+	m_oPool.Release( d.slot ) ;
+	d.slot = -1 ;
+	d.data = NULL ;
+	d.len = 0 ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Log the per-node transmit and per-port receive counters.
+////////////////////////////////////////////////////////////////////////////////
+void CUdpTransport::LogStats() const
+{
+	for ( TxMap::const_iterator it = m_oTx.begin(); it != m_oTx.end(); ++it )
+	{
+		LOG_INFO( "TX STATS: [node:%s] [sent:%lu] [errors:%lu] [bytes:%llu]\n",
+			it->first, it->second.sent, it->second.errors, it->second.bytes ) ;
+	}
+	for ( RxMap::const_iterator it = m_oRx.begin(); it != m_oRx.end(); ++it )
+	{
+		LOG_INFO( "RX STATS: [port:%i] [received:%lu] [dropped:%lu] [truncated:%lu] [queued:%u]\n",
+			it->first, it->second.received, it->second.dropped, it->second.truncated, (unsigned)it->second.queue.size() ) ;
+	}
+}
+
+
+void CUdpTransport::Close()
+{
+	for ( TxMap::iterator it = m_oTx.begin(); it != m_oTx.end(); ++it )
+	{
+		close( it->second.fd ) ;
+		free( (char*)it->first ) ;
+	}
+	m_oTx.clear() ;
+	for ( RxMap::iterator it = m_oRx.begin(); it != m_oRx.end(); ++it )
+	{
+		m_rReactor.Remove( it->second.fd ) ;
+		close( it->second.fd ) ;
+		for ( size_t i = 0; i < it->second.queue.size(); ++i )
+			m_oPool.Release( it->second.queue[i].slot ) ;
+	}
+	m_oRx.clear() ;
+}
+
+
+long long CUdpTransport::NowMs()
+{
+	struct timeval tv ;
+	gettimeofday(&tv, (struct timezone*)NULL) ;
+	return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000 ;
+}
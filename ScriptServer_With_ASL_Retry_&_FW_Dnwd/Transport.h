@@ -0,0 +1,143 @@
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "Misc.h"
+#include "Reactor.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Transmit endpoint of one RF node.
+/// @remarks The socket is bound to the node's backbone port and stays open
+/// for the whole run.
+////////////////////////////////////////////////////////////////////////////////
+struct TxSocket {
+	int	fd ;
+	struct sockaddr_in peer ;
+	unsigned long	sent ;
+	unsigned long	errors ;
+	unsigned long long bytes ;
+	TxSocket() : fd(-1), sent(0), errors(0), bytes(0) {}
+} ;
+
+
+/// datagrams written per sendmmsg() call
+#define TX_BATCH	64
+/// datagrams read per recvmmsg() call
+#define RX_BATCH	32
+/// receive buffers shared by all ackLogger ports
+#define RX_SLOTS	1024
+/// size of one receive buffer, string terminator included: any UDP datagram
+/// fits. Only the pages of the slab that were written to take memory.
+#define RX_SLOT_SZ	65536
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fixed size buffers carved out of one preallocated slab.
+////////////////////////////////////////////////////////////////////////////////
+class CBufferPool {
+public:
+	CBufferPool( unsigned slots, unsigned slotSz ) ;
+	~CBufferPool() ;
+
+public:
+	int   Acquire() ;
+	void  Release( int slot ) ;
+	char* Buffer( int slot ) { return m_pSlab + (size_t)slot * m_nSlotSz ; }
+	unsigned SlotSize() const { return m_nSlotSz ; }
+
+protected:
+	char*	m_pSlab ;
+	unsigned m_nSlotSz ;
+	std::vector<int> m_oFree ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A datagram received from the BBR.
+/// @remarks data points into a pool buffer and is NUL terminated in place.
+/// Whoever pops the datagram from the queue owns the buffer and gives it back
+/// with CUdpTransport::Release().
+////////////////////////////////////////////////////////////////////////////////
+struct Datagram {
+	char*	data ;
+	size_t	len ;
+	int	slot ;
+	struct sockaddr_in from ;
+	Datagram() : data(NULL), len(0), slot(-1) {}
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Receive endpoint bound on an ackLogger port.
+/// @remarks The socket is opened at startup and drained into the queue
+/// whenever the transport gets the chance, so datagrams arriving between two
+/// wait() calls are kept.
+////////////////////////////////////////////////////////////////////////////////
+struct RxSocket {
+	int	fd ;
+	int	port ;
+	std::deque<Datagram> queue ;
+	unsigned long	received ;
+	unsigned long	dropped ;
+	unsigned long	truncated ;
+	RxSocket() : fd(-1), port(0), received(0), dropped(0), truncated(0) {}
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief UDP transport owned by ScriptServer.
+/// @remarks One transmit socket is opened per RF node when the configuration
+/// is parsed and reused for every message sent to that node. One receive
+/// socket is kept open per ackLogger port and watched by the reactor, which
+/// drains every port as soon as data arrives.
+////////////////////////////////////////////////////////////////////////////////
+class CUdpTransport : public CReactorHandler {
+public:
+	CUdpTransport( CReactor& reactor ) ;
+	~CUdpTransport() ;
+
+public:
+	bool OpenTx( const char* rfNode, const char* host, int backbonePort ) ;
+	TxSocket* Tx( const char* rfNode ) ;
+	bool Send( const char* rfNode, const char* buf, size_t len ) ;
+	int  SendBatch( const char* rfNode, const std::vector<std::string>& bufs, size_t first, size_t count ) ;
+
+	bool OpenRx( int ackLoggerPort ) ;
+	RxSocket* Rx( int ackLoggerPort ) ;
+	bool Receive( int ackLoggerPort, long long deadlineMs, Datagram& out ) ;
+	bool Pop( int ackLoggerPort, Datagram& out ) ;
+	void Release( Datagram& d ) ;
+	int  Drain( RxSocket& rx ) ;
+	void DrainAll() ;
+	void OnReadable( int fd ) ;
+
+	void LogStats() const ;
+	void Close() ;
+
+	static long long NowMs() ;
+
+protected:
+	typedef std::map<const char*, TxSocket, cmp_str> TxMap ;
+	typedef std::map<int, RxSocket> RxMap ;
+	void enqueue( RxSocket& rx, int slot, size_t len, const struct sockaddr_in& from ) ;
+
+protected:
+	CReactor& m_rReactor ;
+	TxMap	m_oTx ;
+	RxMap	m_oRx ;
+	CBufferPool	m_oPool ;
+	struct mmsghdr	m_aTxMsgs[TX_BATCH] ;
+	struct iovec	m_aTxIov[TX_BATCH] ;
+	struct mmsghdr	m_aMsgs[RX_BATCH] ;
+	struct iovec	m_aIov[RX_BATCH] ;
+	struct sockaddr_in m_aFrom[RX_BATCH] ;
+	int	m_aSlots[RX_BATCH] ;
+} ;
+
+#endif	/* _TRANSPORT_H_ */
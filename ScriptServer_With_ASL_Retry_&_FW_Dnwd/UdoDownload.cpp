@@ -0,0 +1,389 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "UdoDownload.h"
+
+
+CUdoDownload::CUdoDownload( CUdpTransport& transport, const char* rfNode, int ackLoggerPort
+	, const UdoConfig& cfg, const unsigned char* image, size_t length
+	, int maxBlockSize, int processingTime, int window )
+	: m_rTransport(transport)
+	, m_szRfNode(rfNode)
+	, m_nAckLoggerPort(ackLoggerPort)
+	, m_sObjectId(cfg.udoObjectId)
+	, m_pImage(image)
+	, m_nLength(length)
+	, m_nBlockSize(maxBlockSize)
+	, m_nTimeoutMs((processingTime + 10) * 1000)
+	, m_nWindow(window)
+	, m_eState(UDO_START)
+	, m_nReqId(0)
+	, m_nMsgNo(0)
+	, m_nNextBlock(1)
+	, m_nAcked(0)
+	, m_nBytesAcked(0)
+	, m_nRetransmits(0)
+	, m_nStartMs(0)
+	, m_nDataStartMs(0)
+	, m_nDataEndMs(0)
+{
+	///data size may be smaller than maxBlockSize (this means one block transfer)
+	if ( (size_t)m_nBlockSize > m_nLength ) m_nBlockSize = m_nLength ;
+	if ( m_nBlockSize <= 0 ) m_nBlockSize = 1 ;
+	m_nBlocks = (m_nLength + m_nBlockSize - 1) / m_nBlockSize ;
+	if ( m_nWindow < 1 ) m_nWindow = 1 ;
+	if ( m_nWindow > UDO_MAX_WINDOW ) m_nWindow = UDO_MAX_WINDOW ;
+
+	/// same fields as generateElementsAfterApduUdo(), in TX_RF order
+	std::stringstream tail ;
+	tail << (cfg.securityPolicy.empty() ? "5" : cfg.securityPolicy.c_str())
+		<< ",0,1,1," << cfg.ssIpv6 << "," << cfg.dutIpv6
+		<< ",61617," << cfg.udoPort << ",1,239,7D77,," ;
+	m_sTail = tail.str() ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read a firmware image.
+/// @param fileName	Firmware file
+/// @param startOffset	Offset of the first data block in the file
+/// @param image	File content from startOffset on
+/// @retval false when the file cannot be read or holds no data
+////////////////////////////////////////////////////////////////////////////////
+bool CUdoDownload::ReadImage( const char* fileName, int startOffset, std::vector<unsigned char>& image )
+{
+	FILE* file = fopen(fileName, "rb") ;
+	if ( !file )
+	{
+		printf("Error: could not open file %s \n", fileName) ;
+		return false ;
+	}
+	fseek(file, 0, SEEK_END) ;
+	long length = ftell(file) - startOffset ;
+	fseek(file, startOffset, SEEK_SET) ;
+	if ( length <= 0 )
+	{
+		printf("Error in establishing data size \n") ;
+		fclose(file) ;
+		return false ;
+	}
+	image.resize(length) ;
+	size_t res = fread(&image[0], 1, length, file) ;
+	fclose(file) ;
+	if ( res != (size_t)length )
+	{
+		printf("Reading file error \n") ;
+		image.clear() ;
+		return false ;
+	}
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Send StartDownload.
+////////////////////////////////////////////////////////////////////////////////
+void CUdoDownload::Start()
+{
+	m_nStartMs = CUdpTransport::NowMs() ;
+	m_eState = UDO_START ;
+	LOG_INFO("\tUDO START: [node:%s] [bytes:%u] [blocks:%d] [block size:%d] [window:%d]\n"
+		, m_szRfNode, (unsigned)m_nLength, m_nBlocks, m_nBlockSize, m_nWindow) ;
+
+	char apdu[64] ;
+	unsigned char reqId = nextReqId() ;
+	//05=exec_req  1=SOID  8=UDO_ID  req_id  01=meth_id size  payload
+	sprintf(apdu, "051%s%02X0107%04X%08X00", m_sObjectId.c_str(), reqId, (unsigned short)m_nBlockSize, (unsigned)m_nLength) ;
+	submit(reqId, 0, apdu) ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Match a datagram received on the ackLogger port with a request.
+/// @param d	Received datagram
+/// @retval false when the datagram is not a response to an outstanding request
+////////////////////////////////////////////////////////////////////////////////
+bool CUdoDownload::OnResponse( const Datagram& d )
+{
+	if ( Done() || !d.data )
+		return false ;
+
+	int type ;
+	::getMsgType(d.data, type) ;
+	if ( type != RX_RF )
+		return false ;
+
+	/// RX_RF,MsgNo,APP,...
+	const char *app = strchr(d.data, ',') ;
+	if ( !app || !(app = strchr(app + 1, ',')) )
+		return false ;
+	++app ;
+	size_t appLen = strcspn(app, ",") ;
+	if ( appLen < 10 )
+		return false ;
+
+	char reqIdBuf[3] = { app[4], app[5], 0 } ;
+	RequestMap::iterator it = m_oPending.find( (unsigned char)strtoul(reqIdBuf, NULL, 16) ) ;
+	if ( it == m_oPending.end() )
+		return false ;
+
+	/// 85=exec resp to 05, 84=write resp to 04; SOID/DOID swapped
+	UdoRequest& r = it->second ;
+	std::string expected("8") ;
+	expected += r.apdu[1] ;
+	expected += m_sObjectId + "1" ;
+	if ( strncmp(app, expected.c_str(), expected.length()) )
+		return false ;
+
+	const char *sfc = app + 8 ;
+	if ( m_eState == UDO_APPLY )
+	{
+		if ( strncmp(sfc, "22", 2) )	///operationAccepted
+		{
+			LOG_INFO("\tUDO NACK: [node:%s] [reqID:%02X] [apply] [sfc:%.2s]\n", m_szRfNode, r.reqId, sfc) ;
+			fail("apply rejected") ;
+			return true ;
+		}
+	}
+	else if ( strncmp(sfc, "00", 2) )
+	{
+		LOG_INFO("\tUDO NACK: [node:%s] [reqID:%02X] [block:%d] [sfc:%.2s]\n", m_szRfNode, r.reqId, r.block, sfc) ;
+		if ( r.tries >= UDO_MAX_TRIES )
+		{
+			fail("request rejected") ;
+			return true ;
+		}
+		++m_nRetransmits ;
+		send(r) ;
+		return true ;
+	}
+	acked(it) ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Retransmit the requests that timed out and fill the window.
+////////////////////////////////////////////////////////////////////////////////
+void CUdoDownload::Poll()
+{
+	if ( Done() )
+		return ;
+
+	long long now = CUdpTransport::NowMs() ;
+	for ( RequestMap::iterator it = m_oPending.begin(); it != m_oPending.end(); ++it )
+	{
+		UdoRequest& r = it->second ;
+		if ( now - r.sentMs < timeoutMs() )
+			continue ;
+		if ( r.tries >= (m_eState == UDO_APPLY ? 1 : UDO_MAX_TRIES) )
+		{
+			LOG_INFO("\tUDO TIMEOUT: [node:%s] [reqID:%02X] [block:%d] [tries:%d]\n", m_szRfNode, r.reqId, r.block, r.tries) ;
+			fail("no response") ;
+			return ;
+		}
+		++m_nRetransmits ;
+		send(r) ;
+	}
+
+	if ( m_eState != UDO_DATA )
+		return ;
+	while ( (int)m_oPending.size() < m_nWindow && m_nNextBlock <= m_nBlocks )
+	{
+		int block = m_nNextBlock++ ;
+		size_t pos = (size_t)(block - 1) * m_nBlockSize ;
+		size_t size = blockSize(block) ;
+
+		std::string apdu ;
+		apdu.reserve(16 + size * 2) ;
+		char hdr[32] ;
+		unsigned char reqId = nextReqId() ;
+		///05, soid/doid,  req_id, MethID, Size, APDU - 0518 03 02 sz apdu(blockNo + block)
+		sprintf(hdr, "051%s%02X02%02X%04X", m_sObjectId.c_str(), reqId, (unsigned)(2 + size), block) ;
+		apdu = hdr ;
+		static const char hex[] = "0123456789ABCDEF" ;
+		for ( size_t i = 0; i < size; ++i )
+		{
+			apdu += hex[m_pImage[pos + i] >> 4] ;
+			apdu += hex[m_pImage[pos + i] & 0x0F] ;
+		}
+		submit(reqId, block, apdu.c_str()) ;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Time at which the first outstanding request times out.
+/// @retval absolute time (see CUdpTransport::NowMs), now when nothing is pending
+////////////////////////////////////////////////////////////////////////////////
+long long CUdoDownload::NextDeadline() const
+{
+	long long now = CUdpTransport::NowMs() ;
+	long long deadline = -1 ;
+	for ( RequestMap::const_iterator it = m_oPending.begin(); it != m_oPending.end(); ++it )
+	{
+		long long t = it->second.sentMs + timeoutMs() ;
+		if ( deadline == -1 || t < deadline ) deadline = t ;
+	}
+	return deadline == -1 || deadline < now ? now : deadline ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Log the outcome and the effective throughput of the download.
+////////////////////////////////////////////////////////////////////////////////
+void CUdoDownload::Report() const
+{
+	long long end = m_nDataEndMs ? m_nDataEndMs : CUdpTransport::NowMs() ;
+	long long dataMs = m_nDataStartMs ? end - m_nDataStartMs : 0 ;
+	size_t bytes = BytesAcked() ;
+	LOG_INFO("\tUDO %s: [node:%s] [bytes:%u] [blocks:%d/%d] [window:%d] [retransmits:%lu] [data:%lldms] [rate:%.0f B/s] [total:%lldms]\n"
+		, Failed() ? "FAILED" : (m_eState == UDO_DONE ? "DONE" : "RUNNING")
+		, m_szRfNode, (unsigned)bytes, m_nAcked, m_nBlocks, m_nWindow, m_nRetransmits
+		, dataMs, dataMs ? bytes * 1000.0 / dataMs : 0.0, CUdpTransport::NowMs() - m_nStartMs) ;
+}
+
+
+
+size_t CUdoDownload::BytesAcked() const
+{
+	return m_nBytesAcked ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Size of a DownloadData block; the last one may be short.
+/// @param block	Block number, from 1
+////////////////////////////////////////////////////////////////////////////////
+size_t CUdoDownload::blockSize( int block ) const
+{
+	size_t pos = (size_t)(block - 1) * m_nBlockSize ;
+	return m_nLength - pos < (size_t)m_nBlockSize ? m_nLength - pos : m_nBlockSize ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next reqID neither outstanding nor held.
+/// @remarks Pending and held reqIDs never take all 256 values.
+////////////////////////////////////////////////////////////////////////////////
+unsigned char CUdoDownload::nextReqId()
+{
+	long long now = CUdpTransport::NowMs() ;
+	for ( ;; )
+	{
+		++m_nReqId ;
+		if ( m_oPending.find(m_nReqId) != m_oPending.end() )
+			continue ;
+		std::map<unsigned char, long long>::iterator h = m_oHeld.find(m_nReqId) ;
+		if ( h == m_oHeld.end() )
+			break ;
+		if ( h->second <= now )
+		{
+			m_oHeld.erase(h) ;
+			break ;
+		}
+	}
+	return m_nReqId ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Keep the reqID of an answered request unused while responses to
+/// its other transmissions may still come, so that none of them is taken for
+/// the response to a new request.
+////////////////////////////////////////////////////////////////////////////////
+void CUdoDownload::hold( const UdoRequest& r )
+{
+	if ( r.tries < 2 )
+		return ;
+	long long now = CUdpTransport::NowMs() ;
+	for ( std::map<unsigned char, long long>::iterator h = m_oHeld.begin(); h != m_oHeld.end(); )
+	{
+		if ( h->second <= now )
+			m_oHeld.erase(h++) ;
+		else
+			++h ;
+	}
+	if ( m_oHeld.size() < UDO_MAX_HELD )
+		m_oHeld[r.reqId] = r.sentMs + timeoutMs() ;
+}
+
+
+void CUdoDownload::submit( unsigned char reqId, int block, const char* apdu )
+{
+	UdoRequest& r = m_oPending[reqId] ;
+	r.reqId = reqId ;
+	r.block = block ;
+	r.apdu = apdu ;
+	r.tries = 0 ;
+	send(r) ;
+}
+
+
+void CUdoDownload::send( UdoRequest& r )
+{
+	std::stringstream line ;
+	line << "TX_RF," << ++m_nMsgNo << "," << r.apdu << "," << m_sTail ;
+	stampline(line) ;
+	std::string out( line.str() ) ;
+	r.sentMs = CUdpTransport::NowMs() ;
+	++r.tries ;
+	if ( m_rTransport.Send(m_szRfNode, out.c_str(), out.length()) )
+		LOG_DEBUG("\tSENT UDP: [%s]: [node:%s] [%s]\n", szNow(), m_szRfNode, out.c_str()) ;
+}
+
+
+int CUdoDownload::timeoutMs() const
+{
+	return m_eState == UDO_APPLY ? UDO_APPLY_TIMEOUT * 1000 : m_nTimeoutMs ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Retire an answered request and move to the next phase when due.
+////////////////////////////////////////////////////////////////////////////////
+void CUdoDownload::acked( RequestMap::iterator it )
+{
+	int block = it->second.block ;
+	hold(it->second) ;
+	m_oPending.erase(it) ;
+	char apdu[64] ;
+	unsigned char reqId ;
+
+	switch ( m_eState )
+	{
+	case UDO_START:
+		m_eState = UDO_DATA ;
+		m_nDataStartMs = CUdpTransport::NowMs() ;
+		break ;
+	case UDO_DATA:
+		if ( block )
+		{
+			++m_nAcked ;
+			m_nBytesAcked += blockSize(block) ;
+		}
+		if ( m_nAcked < m_nBlocks )
+			break ;
+		m_nDataEndMs = CUdpTransport::NowMs() ;
+		m_eState = UDO_END ;
+		reqId = nextReqId() ;
+		//05=exec_req  1=SOID  7=UDO_ID  req_id  meth_id  size  payload=00(success)
+		sprintf(apdu, "051%s%02X030100", m_sObjectId.c_str(), reqId) ;
+		submit(reqId, 0, apdu) ;
+		break ;
+	case UDO_END:
+		m_eState = UDO_APPLY ;
+		reqId = nextReqId() ;
+		//04=write_req  1=SOID  7=UDO_ID  req_id  attr_id  size  payload=01(apply)
+		sprintf(apdu, "041%s%02X040101", m_sObjectId.c_str(), reqId) ;
+		submit(reqId, 0, apdu) ;
+		break ;
+	case UDO_APPLY:
+		m_eState = UDO_DONE ;
+		Report() ;
+		break ;
+	default:
+		break ;
+	}
+}
+
+
+void CUdoDownload::fail( const char* reason )
+{
+	LOG_ERROR("Error - UDO download to %s failed: %s\n", m_szRfNode, reason) ;
+	m_eState = UDO_FAILED ;
+	m_oPending.clear() ;
+	Report() ;
+}
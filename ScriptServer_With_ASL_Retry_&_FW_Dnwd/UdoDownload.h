@@ -0,0 +1,143 @@
+#ifndef _UDO_DOWNLOAD_H_
+#define _UDO_DOWNLOAD_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Transport.h"
+
+/// outstanding DownloadData requests allowed at most; keeps the 8 bit reqIDs
+/// of the window unambiguous
+#define UDO_MAX_WINDOW	128
+/// reqIDs kept unused at most while a late response to them may come; with
+/// the window, leaves a reqID free
+#define UDO_MAX_HELD	(255 - UDO_MAX_WINDOW)
+/// transmissions of a request before the download is given up
+#define UDO_MAX_TRIES	4
+/// time the DUT gets to apply the new firmware, in seconds
+#define UDO_APPLY_TIMEOUT	400
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief UDO values read from ss.ini [EXPORT].
+////////////////////////////////////////////////////////////////////////////////
+struct UdoConfig {
+	std::string ssIpv6 ;
+	std::string dutIpv6 ;
+	std::string udoPort ;
+	std::string udoObjectId ;
+	std::string securityPolicy ;
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief DUT to download to and the RF node it is reached through.
+/// @remarks dutVar names the ss.ini [EXPORT] key holding the DUT address.
+////////////////////////////////////////////////////////////////////////////////
+struct UdoTarget {
+	std::string dutVar ;
+	std::string rfNode ;
+	std::string dutIpv6 ;
+	UdoTarget( const char* dut, const char* node ) : dutVar(dut), rfNode(node) {}
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A UDO request waiting for its response.
+////////////////////////////////////////////////////////////////////////////////
+struct UdoRequest {
+	unsigned char reqId ;
+	int	block ;		///< DownloadData block number, 0 for the other requests
+	std::string apdu ;
+	long long sentMs ;
+	int	tries ;
+	UdoRequest() : reqId(0), block(0), sentMs(0), tries(0) {}
+} ;
+
+
+enum UDO_STATE {
+	UDO_START,
+	UDO_DATA,
+	UDO_END,
+	UDO_APPLY,
+	UDO_DONE,
+	UDO_FAILED
+} ;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief In-process UDO firmware download to one DUT.
+/// @remarks Runs the same requests as the script written by
+/// ScriptServer::GenerateUdoTest(): StartDownload, DownloadData for every
+/// block, EndDownload and Apply. Up to window DownloadData requests are kept
+/// outstanding; responses are matched to their request by the reqID at APP
+/// offset 4. Responses carry no block number, so the reqID of a request sent
+/// more than once is not used again before the responses to its other
+/// transmissions are due. A request whose response does not come in time, or comes
+/// with a failure SFC, is sent again on its own.
+/// The session does not block: Start() sends the first request, OnResponse()
+/// takes the datagrams received on the ackLogger port and Poll() sends what
+/// the window allows and retransmits what timed out.
+////////////////////////////////////////////////////////////////////////////////
+class CUdoDownload {
+public:
+	CUdoDownload( CUdpTransport& transport, const char* rfNode, int ackLoggerPort
+		, const UdoConfig& cfg, const unsigned char* image, size_t length
+		, int maxBlockSize, int processingTime, int window ) ;
+
+public:
+	void Start() ;
+	bool OnResponse( const Datagram& d ) ;
+	void Poll() ;
+	long long NextDeadline() const ;
+	void Report() const ;
+	size_t BytesAcked() const ;
+	void Fail( const char* reason ) { fail(reason) ; }
+
+	bool Done() const { return m_eState == UDO_DONE || m_eState == UDO_FAILED ; }
+	bool Failed() const { return m_eState == UDO_FAILED ; }
+	int  AckLoggerPort() const { return m_nAckLoggerPort ; }
+	const char* RfNode() const { return m_szRfNode ; }
+
+	static bool ReadImage( const char* fileName, int startOffset, std::vector<unsigned char>& image ) ;
+
+protected:
+	typedef std::map<unsigned char, UdoRequest> RequestMap ;
+	unsigned char nextReqId() ;
+	void hold( const UdoRequest& r ) ;
+	size_t blockSize( int block ) const ;
+	void submit( unsigned char reqId, int block, const char* apdu ) ;
+	void send( UdoRequest& r ) ;
+	int  timeoutMs() const ;
+	void acked( RequestMap::iterator it ) ;
+	void fail( const char* reason ) ;
+
+protected:
+	CUdpTransport& m_rTransport ;
+	const char*	m_szRfNode ;
+	int	m_nAckLoggerPort ;
+	std::string	m_sObjectId ;
+	std::string	m_sTail ;		///< TX_RF fields following the APDU
+	const unsigned char* m_pImage ;
+	size_t	m_nLength ;
+	int	m_nBlockSize ;
+	int	m_nBlocks ;
+	int	m_nTimeoutMs ;
+	int	m_nWindow ;
+
+	UDO_STATE m_eState ;
+	RequestMap m_oPending ;
+	std::map<unsigned char, long long> m_oHeld ;	///< reqID -> time it may be used again
+	unsigned char m_nReqId ;
+	int	m_nMsgNo ;
+	int	m_nNextBlock ;
+	int	m_nAcked ;
+	size_t	m_nBytesAcked ;
+	unsigned long m_nRetransmits ;
+	long long m_nStartMs ;
+	long long m_nDataStartMs ;
+	long long m_nDataEndMs ;
+} ;
+
+#endif	/* _UDO_DOWNLOAD_H_ */
@@ -0,0 +1,268 @@
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+#include "XmlScript.h"
+#include "tinyxml.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Field of the message part of a step, in layout order.
+////////////////////////////////////////////////////////////////////////////////
+struct MsgField {
+	const char* element ;
+	const char* attribute ;	///< value taken from this attribute instead of the text
+	bool	hex ;		///< blanks removed
+} ;
+
+static const MsgField TX_CFG_FIELDS[] = {
+	{"MsgNo",         NULL,   false},
+	{"APDU",          NULL,   true},
+	{NULL,            NULL,   false}
+} ;
+
+static const MsgField TX_RF_FIELDS[] = {
+	{"MsgNo",         NULL,   false},
+	{"APDU",          NULL,   true},
+	{"TLEncrypt",     NULL,   false},
+	{"Priority",      NULL,   false},
+	{"DiscardEligible",NULL,  false},
+	{"ECN",           NULL,   false},
+	{"IPv6Src",       "addr", false},
+	{"IPv6Dst",       "addr", false},
+	{"IPv6Src",       "port", false},
+	{"IPv6Dst",       "port", false},
+	{"ContractID",    NULL,   false},
+	{"UDPCompression",NULL,   false},
+	{"NLHdr",         NULL,   true},
+	{"LinkMsg",       NULL,   true},
+	{"DLLHdr",        NULL,   true},
+	{NULL,            NULL,   false}
+} ;
+
+static const MsgField TX_RSP_FIELDS[] = {
+	{"MsgNo",         NULL,   false},
+	{"APDU",          NULL,   true},
+	{"TLEncrypt",     NULL,   false},
+	{"Priority",      NULL,   false},
+	{"DiscardEligible",NULL,  false},
+	{"ECN",           NULL,   false},
+	{"IPv6Src",       "addr", false},
+	{"IPv6Dst",       "addr", false},
+	{"IPv6Src",       "port", false},
+	{"IPv6Dst",       "port", false},
+	{"ContractID",    NULL,   false},
+	{"UDPCompression",NULL,   false},
+	{"NLHdr",         NULL,   true},
+	{"LinkMsg",       NULL,   true},
+	{"DLLHdr",        NULL,   true},
+	{"OrigAPDU",      NULL,   true},
+	{"OrigTLHdr",     NULL,   true},
+	{"OrigNLHdr",     NULL,   true},
+	{"OrigDLLHdr",    NULL,   true},
+	{NULL,            NULL,   false}
+} ;
+
+
+static const MsgField* fieldsOf( const std::string& type )
+{
+	if ( type == "TX_RF" ) return TX_RF_FIELDS ;
+	if ( type == "TX_RSP" ) return TX_RSP_FIELDS ;
+	return TX_CFG_FIELDS ;
+}
+
+
+static std::string trim( const char* s )
+{
+	if ( !s ) return "" ;
+	while ( isspace(*s) ) ++s ;
+	size_t n = strlen(s) ;
+	while ( n && isspace(s[n-1]) ) --n ;
+	return std::string(s, n) ;
+}
+
+
+static std::string noBlanks( const char* s )
+{
+	std::string out ;
+	for ( ; s && *s; ++s )
+		if ( !isspace(*s) ) out += *s ;
+	return out ;
+}
+
+
+static std::string attr( const TiXmlElement* el, const char* name, const char* def = "" )
+{
+	const char* v = el->Attribute(name) ;
+	return trim( v ? v : def ) ;
+}
+
+
+static std::string text( const TiXmlElement* el, bool hex = false )
+{
+	if ( !el ) return "" ;
+	return hex ? noBlanks(el->GetText()) : trim(el->GetText()) ;
+}
+
+
+static bool isMsgField( const MsgField* f, const char* name )
+{
+	for ( ; f->element; ++f )
+		if ( !strcmp(f->element, name) ) return true ;
+	return false ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compile an XML script.
+/// @param xmlFile	Script file
+/// @param out		CSV steps, one line per MSG
+/// @retval false when the file cannot be parsed or uses an unknown element;
+/// see Error()
+////////////////////////////////////////////////////////////////////////////////
+bool CXmlScript::Compile( const char* xmlFile, std::ostream& out )
+{
+	TiXmlDocument doc( xmlFile ) ;
+	if ( !doc.LoadFile() )
+	{
+		std::stringstream err ;
+		err << xmlFile << ":" << doc.ErrorRow() << ": " << doc.ErrorDesc() ;
+		m_sError = err.str() ;
+		return false ;
+	}
+	const TiXmlElement* root = doc.RootElement() ;
+	if ( !root || strcmp(root->Value(), "MsgList") )
+		return error(root, "root element is not MsgList") ;
+
+	for ( const TiXmlElement* msg = root->FirstChildElement(); msg; msg = msg->NextSiblingElement() )
+	{
+		if ( strcmp(msg->Value(), "MSG") )
+			return error(msg, "unknown element") ;
+		if ( !compileMsg(msg, out) )
+			return false ;
+	}
+	return true ;
+}
+
+
+bool CXmlScript::compileMsg( const TiXmlElement* msg, std::ostream& out )
+{
+	std::string type = text( msg->FirstChildElement("Type") ) ;
+	const MsgField* fields = fieldsOf(type) ;
+	std::string timeout ;
+	std::vector<std::string> waits, saves, copies ;
+
+	for ( const TiXmlElement* el = msg->FirstChildElement(); el; el = el->NextSiblingElement() )
+	{
+		const char* name = el->Value() ;
+		if ( !strcmp(name, "Wait") )
+		{
+			if ( !compileWait(el, waits, timeout) )
+				return false ;
+			continue ;
+		}
+		if ( !strcmp(name, "Description") || !strcmp(name, "RFNode") || !strcmp(name, "Type")
+		||   isMsgField(fields, name) )
+			continue ;
+
+		/// Save/Copy, on their own or grouped in a Modify element
+		const TiXmlElement* first = el ;
+		const TiXmlElement* last = el->NextSiblingElement() ;
+		if ( !strcmp(name, "Modify") )
+		{
+			first = el->FirstChildElement() ;
+			last = NULL ;
+		}
+		for ( const TiXmlElement* m = first; m && m != last; m = m->NextSiblingElement() )
+		{
+			std::string rec ;
+			if ( !strcmp(m->Value(), "Save") )
+			{
+				rec = attr(m, "id") + "|" + attr(m, "operation") + "|" + attr(m, "size", "0")
+					+ "|" + attr(m, "layer") + "|" + attr(m, "offset", "0") ;
+				saves.push_back(rec) ;
+			}
+			else if ( !strcmp(m->Value(), "Copy") )
+			{
+				rec = attr(m, "id") + "|" + attr(m, "size", "0")
+					+ "|" + attr(m, "srclayer") + "|" + attr(m, "srcoffset", "0")
+					+ "|" + attr(m, "dstlayer") + "|" + attr(m, "dstoffset", "0") ;
+				copies.push_back(rec) ;
+			}
+			else
+				return error(m, "unknown element") ;
+		}
+	}
+	if ( timeout.empty() )
+		timeout = attr(msg, "timeout", "0") ;
+
+	std::string message ;
+	if ( !compileMessage(msg, type, message) )
+		return false ;
+
+	out << text( msg->FirstChildElement("Description") )
+	    << ":" << text( msg->FirstChildElement("RFNode") )
+	    << ":" << type
+	    << ":" << timeout
+	    << ":" << attr(msg, "policy")
+	    << ":" << attr(msg, "loop") ;
+	for ( size_t i = 0; i < waits.size(); ++i ) out << ":" << waits[i] ;
+	out << ":" ;
+	for ( size_t i = 0; i < saves.size(); ++i ) out << ":" << saves[i] ;
+	out << ":" ;
+	for ( size_t i = 0; i < copies.size(); ++i ) out << ":" << copies[i] ;
+	out << ":" << "," << message << "\n" ;
+	return true ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compile the Match elements of a Wait element.
+/// @param wait		Wait element
+/// @param waits	Wait records
+/// @param timeout	Step timeout, taken from the first Wait element
+////////////////////////////////////////////////////////////////////////////////
+bool CXmlScript::compileWait( const TiXmlElement* wait, std::vector<std::string>& waits, std::string& timeout )
+{
+	if ( timeout.empty() )
+		timeout = attr(wait, "timeout") ;
+
+	for ( const TiXmlElement* m = wait->FirstChildElement(); m; m = m->NextSiblingElement() )
+	{
+		if ( strcmp(m->Value(), "Match") )
+			return error(m, "unknown element") ;
+		/// op|typechk|bitchk|reversechk|id|srclayer|srcoffset|srcsize|type|layer|offset|size|data[|mask]
+		std::string rec = attr(m, "operator", "eq")
+			+ "|" + attr(m, "typechk", "0") + "|" + attr(m, "bitchk", "0") + "|" + attr(m, "reversechk", "0")
+			+ "|" + attr(m, "id") + "|" + attr(m, "srclayer") + "|" + attr(m, "srcoffset") + "|" + attr(m, "srcsize", "0")
+			+ "|" + attr(m, "type") + "|" + attr(m, "layer")
+			+ "|" + attr(m, "offset", "0") + "|" + attr(m, "size", "0") ;
+		if ( m->Attribute("mask") )
+			rec += "|" + ( m->Attribute("value") ? attr(m, "value") : text(m, true) ) + "|" + attr(m, "mask") ;
+		else
+			rec += "|" + text(m, true) ;
+		waits.push_back(rec) ;
+	}
+	return true ;
+}
+
+
+bool CXmlScript::compileMessage( const TiXmlElement* msg, const std::string& type, std::string& out )
+{
+	out = type ;
+	for ( const MsgField* f = fieldsOf(type); f->element; ++f )
+	{
+		const TiXmlElement* el = msg->FirstChildElement(f->element) ;
+		out += "," ;
+		if ( !el ) continue ;
+		out += f->attribute ? attr(el, f->attribute) : text(el, f->hex) ;
+	}
+	return true ;
+}
+
+
+bool CXmlScript::error( const TiXmlElement* at, const char* what )
+{
+	std::stringstream err ;
+	err << what ;
+	if ( at ) err << " <" << at->Value() << "> at line " << at->Row() ;
+	m_sError = err.str() ;
+	return false ;
+}
@@ -0,0 +1,47 @@
+#ifndef _XML_SCRIPT_H_
+#define _XML_SCRIPT_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+class TiXmlElement ;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compiles an XML test script into the CSV steps read by
+/// ScriptServer::RunScript(), in process.
+/// @remarks Produces the same lines as tocsv.xsl, one per MSG:
+///	desc:rfnode:type:timeout:policy:loop:waits...::saves...::copies...:,message
+/// A Match with a mask matches the bits of its mask only, against its
+/// value; its record carries the mask after the data. tocsv.xsl does not
+/// know it.
+/// <MsgList>
+///   <MSG policy="norecv" loop="0;4;1">
+///     <Wait timeout="5"><Match type="RX_RF" layer="APP" offset="0" size="4"
+///        [operator="eq" typechk bitchk reversechk id srclayer srcoffset srcsize]>8581</Match>
+///       <Match type="RX_RF" layer="APP" offset="4" size="4" mask="0x0F30" value="0x0210"/></Wait>
+///     <Save id="x" operation="" size="2" layer="APP" offset="4"/>
+///     <Copy id="x" size="2" srclayer="APP" srcoffset="0" dstlayer="APP" dstoffset="4"/>
+///     <Description/> <RFNode/> <Type/> <MsgNo/> <APDU/> ... message fields
+///   </MSG>
+/// </MsgList>
+/// The message fields follow the layout of the type (see Attribs.h); blanks
+/// are removed from the hex fields. A script using an element the compiler
+/// does not know is refused.
+////////////////////////////////////////////////////////////////////////////////
+class CXmlScript {
+public:
+	bool Compile( const char* xmlFile, std::ostream& out ) ;
+	const std::string& Error() const { return m_sError ; }
+
+protected:
+	bool compileMsg( const TiXmlElement* msg, std::ostream& out ) ;
+	bool compileWait( const TiXmlElement* wait, std::vector<std::string>& waits, std::string& timeout ) ;
+	bool compileMessage( const TiXmlElement* msg, const std::string& type, std::string& out ) ;
+	bool error( const TiXmlElement* at, const char* what ) ;
+
+protected:
+	std::string m_sError ;
+} ;
+
+#endif	/* _XML_SCRIPT_H_ */
@@ -1,15 +1,19 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
 #include <unistd.h>
 #include <cstring>
-#include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include "ScriptServer.h"
+#include "XmlScript.h"
+#include "ScriptCache.h"
 #define VERSION "2.3.5.3"
 
 char	*g_InFile   =NULL;
 char *firmwareFileName = 0;
+int   udoWindow = 0;
 
 ////////////////////////////////////////////////////////////////////////////////
 static void usage()
@@ -20,8 +24,12 @@ static void usage()
 	        "	 -o   <OUT_FILE>	Output file.\n"
 	        "	 -t   <TIMEOUT>		Timeout to wait for each response.\n"
 	        "	 -l   <LOG_LEVEL>	Log level: 1=ERROR, 2=WARN, 3=INFO, 4=DEBUG. Default level used is INFO.\n"
+	        "	 -p             	Run consecutive steps addressed to different RF nodes in parallel. Each step of a window sends its message as soon as its own response matched, so the messages may go out in another order than in the script.\n"
+	        "	 -i             	Watch ss.ini while the script runs: the [EXPORT] placeholders take the new values as soon as the file changes.\n"
+	        "	 -s   <SNAPSHOT_FILE>	Load the values saved by the previous scripts from SNAPSHOT_FILE, and write them back with the ones this script saves.\n"
 	        "	 -v             	Print Version\n"
-	        "	 -u   <FIRMWARE_FILE [MAX_BLOCK_SIZE DATA_OFFSET PROCESSING_TIME]>	UDO specific option. Needed input: firmware file name. Optional parameters: maximum block size, data offset in file, processing time for a packet on DUT.\n"
+	        "	 -w   <WINDOW>		UDO specific option, given before -u. Download the firmware in process, keeping up to WINDOW DownloadData requests outstanding, instead of generating UDOTest.xml.\n"
+	        "	 -u   <FIRMWARE_FILE [MAX_BLOCK_SIZE DATA_OFFSET PROCESSING_TIME] [DUT_VAR@RF_NODE ...]>	UDO specific option. Needed input: firmware file name. Optional parameters: maximum block size, data offset in file, processing time for a packet on DUT, DUTs to download to in parallel (ss.ini [EXPORT] key of the DUT address @ RF node).\n"
 	      );
 	exit(1);
 }
@@ -32,7 +40,7 @@ int main(int argc, char* argv[])
 {
 	int c;
 	int optionsCount = 0; //used to exit when an option cannot be used together with other options; eg: "-f -u"
-	while ( -1 != (c=getopt(argc, argv, "hf:o:t:l:vu:")) )
+	while ( -1 != (c=getopt(argc, argv, "hf:o:t:l:ps:iw:vu:")) )
 	{
 		switch (c)
 		{
@@ -52,6 +60,21 @@ int main(int argc, char* argv[])
 			g_stFlog.SetLogLevel( CFLog::LogLevel(atoi(optarg)) );
 			++optionsCount;
 			break ;
+		case 'p':
+			g_oCfg.Parallel = true ;
+			++optionsCount;
+			break ;
+		case 'i':
+			g_oCfg.WatchConfig = true ;
+			++optionsCount;
+			break ;
+		case 's':
+			g_oCfg.StorageFile = optarg ;
+			++optionsCount;
+			break ;
+		case 'w':
+			udoWindow = atoi(optarg) ;	/// qualifies -u, not counted as an option
+			break ;
 		case 'u':
 		{
 			if (optionsCount) {
@@ -67,19 +90,37 @@ int main(int argc, char* argv[])
 				printf ("Non-option argument %s \n", argv[index]);
 			}
 
-			int index = optind;
-			if (index < argc) {
-				maxBlockSize = atoi(argv[index]);
-				if (++index < argc) {
-					startOffset = atoi(argv[index]);
-					if (++index < argc) {
-						processingTime = atoi(argv[index]);
-					}
+			///DUT_VAR@RF_NODE arguments select the DUTs; the others are the numeric parameters, in order
+			std::vector<UdoTarget> targets;
+			int numbers[3] = { maxBlockSize, startOffset, processingTime };
+			int nbNumbers = 0;
+			for (int index = optind; index < argc; index++) {
+				char *at = strchr(argv[index], '@');
+				if (at) {
+					*at = 0;
+					targets.push_back(UdoTarget(argv[index], at + 1));
+				} else if (nbNumbers < 3) {
+					numbers[nbNumbers++] = atoi(argv[index]);
 				}
 			}
+			maxBlockSize = numbers[0];
+			startOffset = numbers[1];
+			processingTime = numbers[2];
 			printf("Parameters: maxBlockSize=%d startOffset=%d processingTime=%d \n", maxBlockSize, startOffset, processingTime);
 
+			///the generated script is bound to DUT1_IPV6Add@RF_test_point1; other DUTs are downloaded to in process
+			if (!targets.empty() && udoWindow <= 0) {
+				udoWindow = 1;
+			}
+
 			ScriptServer scriptServer;
+			if (udoWindow > 0) {
+				strcpy(g_oCfg.logFile, "UDODownload.log");
+				g_stFlog.LogSink( new CConsoleFileSink(g_oCfg.logFile) );
+				bool ok = scriptServer.RunUdoDownload(firmwareFileName, maxBlockSize, startOffset, processingTime, udoWindow, targets);
+				printf("script_server exit");
+				return ok ? 0 : 1;
+			}
 			scriptServer.GenerateUdoTest(firmwareFileName, maxBlockSize, startOffset, processingTime);
 
 			printf("script_server exit");
@@ -91,7 +132,7 @@ int main(int argc, char* argv[])
 			exit(0);
 		case '?':
 			//printf("Error - No such option: `%c'\n\n", optopt);
-            if (optopt == 'f' || optopt == 'o' || optopt == 't' || optopt == 'l' || optopt == 'u') {
+            if (optopt == 'f' || optopt == 'o' || optopt == 't' || optopt == 'l' || optopt == 's' || optopt == 'w' || optopt == 'u') {
             	fprintf (stderr, "Option -%c requires an argument.\n", optopt);
             }
             else if (isprint (optopt)) {
@@ -126,30 +167,40 @@ int main(int argc, char* argv[])
 		}
 	}
 	LOG_INFO("Entered "<<"the "<<"scriptserver\n");
-	char cmd[1024];
-	sprintf( cmd, "sabcmd ../../Config/tocsv.xsl %s %s", g_InFile, g_oCfg.InCsvFile );
-	system(cmd);
 
-	std::fstream filestr;
-	std::istream* in;
+	std::stringstream compiled;
+	std::istream* in = NULL;
+	CScriptCache cache;
 
+	if ( g_InFile[0] != '-' && access(g_InFile, R_OK) )
+	{
+		LOG_ERROR("Error - Failed to open input file [%s]: %s\n", g_InFile, strerror(errno));
+		exit(1);
+	}
 	if ( g_InFile[0] == '-' )
 		in = &std::cin ;
+	else if ( cache.Open(g_InFile, "../../Config/ss.ini", g_oCfg.WatchConfig) )
+	{
+		LOG_INFO("Script loaded from %s\n", cache.Path());
+	}
 	else
 	{
-		filestr.open( g_oCfg.InCsvFile, std::fstream::in );
-		if ( filestr.fail() )
+		CXmlScript xml ;
+		if ( !xml.Compile(g_InFile, compiled) )
 		{
-			printf("Error - Failed to open input file [%s]\n", argv[optind]);
+			LOG_ERROR("Error - Unable to compile %s: %s\n", g_InFile, xml.Error().c_str());
 			exit(1);
 		}
-		in = &filestr ;
+		///RunScript() stores the steps in the cache once compiled
+		in = &compiled ;
 	}
+	///the ids of the snapshot are known before the script is compiled
+	if ( g_oCfg.StorageFile )
+		g_oCfg.Storage.Load( g_oCfg.StorageFile );
 	ScriptServer ss ;
-	ss.RunScript(in);
+	ss.RunScript(in, cache);
+	if ( g_oCfg.StorageFile )
+		g_oCfg.Storage.Store( g_oCfg.StorageFile );
 
-	if (filestr.is_open())
-		filestr.close();
-	unlink( g_oCfg.InCsvFile ); //erase csv file from disk
 	return 0;	//Success
 }